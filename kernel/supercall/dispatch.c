@@ -1335,6 +1335,119 @@ static int do_yz_patch_text(void __user *arg)
 		cmd.pid);
 	return 0;
 }
+
+/*
+ * Apply many text patches to one task with a single supercall. The batch is
+ * all-or-nothing: every site is saved first and a failed write restores the
+ * sites already written, so the caller can release what they branch to.
+ * cmd.applied reports how many leading sites may still be patched (only
+ * nonzero on failure if a restore failed too).
+ */
+static int do_yz_patch_text_batch(void __user *arg)
+{
+	struct yz_patch_text_batch_cmd cmd;
+	struct yz_patch_text_batch_cmd __user *ucmd = arg;
+	struct yz_patch_text_entry *ents = NULL;
+	struct task_struct *task;
+	u8 *data = NULL;
+	u8 *orig = NULL;
+	u32 i, j, applied = 0, total = 0;
+	int n, ret = 0;
+
+	if (copy_from_user(&cmd, arg, sizeof(cmd)))
+		return -EFAULT;
+	if (cmd.count == 0 || cmd.count > YZ_PATCH_BATCH_MAX ||
+	    cmd.data_len == 0 || cmd.data_len > YZ_PATCH_BATCH_BYTES)
+		return -EINVAL;
+
+	ents = kmalloc_array(cmd.count, sizeof(*ents), GFP_KERNEL);
+	data = kmalloc(cmd.data_len, GFP_KERNEL);
+	orig = kmalloc(cmd.data_len, GFP_KERNEL);
+	if (!ents || !data || !orig) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	if (copy_from_user(ents, (void __user *)(uintptr_t)cmd.entries,
+			   cmd.count * sizeof(*ents)) ||
+	    copy_from_user(data, (void __user *)(uintptr_t)cmd.data,
+			   cmd.data_len)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	for (i = 0; i < cmd.count; i++) {
+		if (ents[i].len == 0 || ents[i].off > cmd.data_len ||
+		    ents[i].len > cmd.data_len - ents[i].off ||
+		    ents[i].addr == 0 || ents[i].addr >= TASK_SIZE ||
+		    ents[i].addr + ents[i].len < ents[i].addr ||
+		    ents[i].addr + ents[i].len > TASK_SIZE) {
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	rcu_read_lock();
+	task = get_pid_task(find_vpid(cmd.pid), PIDTYPE_PID);
+	rcu_read_unlock();
+	if (!task) {
+		ret = -ESRCH;
+		goto out;
+	}
+
+	/* cmd.pid is checked by zygiskd via SO_PEERCRED. */
+
+	for (i = 0; i < cmd.count; i++) {
+		n = access_process_vm(task, (unsigned long)ents[i].addr,
+				      orig + ents[i].off, ents[i].len,
+				      FOLL_FORCE);
+		if (n != (int)ents[i].len) {
+			pr_warn("yz_patch_text_batch: read %d/%u @0x%llx pid=%u\n",
+				n, ents[i].len, ents[i].addr, cmd.pid);
+			ret = -EFAULT;
+			goto put;
+		}
+	}
+	for (i = 0; i < cmd.count; i++) {
+		n = access_process_vm(task, (unsigned long)ents[i].addr,
+				      data + ents[i].off, ents[i].len,
+				      FOLL_FORCE | FOLL_WRITE);
+		if (n != (int)ents[i].len) {
+			pr_warn("yz_patch_text_batch: wrote %d/%u @0x%llx pid=%u\n",
+				n, ents[i].len, ents[i].addr, cmd.pid);
+			ret = -EFAULT;
+			break;
+		}
+		total += ents[i].len;
+	}
+	if (!ret) {
+		applied = cmd.count;
+	} else {
+		/* Undo sites 0..i; site i may be partly written. */
+		for (j = i + 1; j-- > 0;) {
+			n = access_process_vm(task,
+					      (unsigned long)ents[j].addr,
+					      orig + ents[j].off, ents[j].len,
+					      FOLL_FORCE | FOLL_WRITE);
+			if (n != (int)ents[j].len && !applied) {
+				pr_err("yz_patch_text_batch: restore failed @0x%llx pid=%u\n",
+				       ents[j].addr, cmd.pid);
+				applied = j + 1;
+			}
+		}
+	}
+put:
+	put_task_struct(task);
+	if (!ret)
+		pr_info("yz_patch_text_batch: %u site(s), %u byte(s) pid=%u\n",
+			cmd.count, total, cmd.pid);
+	/* A zero return already tells the caller everything was applied. */
+	if (put_user(applied, &ucmd->applied))
+		pr_warn("yz_patch_text_batch: cannot report applied count\n");
+out:
+	kfree(orig);
+	kfree(data);
+	kfree(ents);
+	return ret;
+}
 #endif // #ifdef CONFIG_KSU_YUKIZYGISK
 
 // IOCTL handlers mapping table
@@ -1518,6 +1631,10 @@ static const struct ksu_ioctl_cmd_map ksu_ioctl_handlers[] = {
      .name = "YZ_PATCH_TEXT",
      .handler = do_yz_patch_text,
      .perm_check = only_root},
+    {.cmd = KSU_IOCTL_YZ_PATCH_TEXT_BATCH,
+     .name = "YZ_PATCH_TEXT_BATCH",
+     .handler = do_yz_patch_text_batch,
+     .perm_check = only_root},
     {.cmd = KSU_IOCTL_YZ_RELOAD,
      .name = "YZ_RELOAD",
      .handler = do_yz_reload,
@@ -179,11 +179,37 @@ struct yz_module_load_policy_cmd {
   __s32 dirfd;
 };
 
+#define KSU_IOCTL_YZ_PATCH_TEXT_BATCH _IOC(_IOC_READ | _IOC_WRITE, 'K', 62, 0)
+
+#define YZ_PATCH_BATCH_MAX 64 /* entries per batch */
+#define YZ_PATCH_BATCH_BYTES 4096 /* total payload budget per batch */
+
+struct yz_patch_text_entry {
+  __u64 addr;
+  __u32 len;
+  __u32 off; /* into the batch payload */
+};
+
+struct yz_patch_text_batch_cmd {
+  __u32 pid;
+  __u32 count;
+  __u32 data_len;
+  __u32 applied; /* out: leading entries that may still be patched */
+  __u64 entries; /* struct yz_patch_text_entry[count] */
+  __u64 data;    /* payload bytes[data_len] */
+};
+
 struct yz_config {
   __u8 yukilinker;
   __u8 denylist_mode;
   __u8 dmesg_log;
   __u8 reserved;
+  /* soinfo layout probed by the first zygote; all zero until reported */
+  __u16 soinfo_size_off;
+  __u16 soinfo_next_off;
+  __u16 soinfo_ctor_off;
+  __u16 reserved2;
+  __u64 linker_id; /* build-id prefix of the linker the offsets belong to */
 };
 
 #endif /* _UAPI_YUKIZYGISK_H */
@@ -0,0 +1,172 @@
+#include "kallsyms.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace kallsyms {
+
+namespace {
+
+// /proc/kallsyms is generated per read() call; large reads keep the number
+// of round trips into the kernel low (GKI kallsyms is ~8 MiB).
+constexpr size_t READ_CHUNK = 256 * 1024;
+
+uint64_t hash_name(std::string_view name) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool parse_hex(const char* begin, const char* end, uint64_t* out) {
+    if (begin == end || end - begin > 16)
+        return false;
+    uint64_t value = 0;
+    for (const char* p = begin; p != end; ++p) {
+        unsigned digit;
+        if (*p >= '0' && *p <= '9')
+            digit = static_cast<unsigned>(*p - '0');
+        else if (*p >= 'a' && *p <= 'f')
+            digit = static_cast<unsigned>(*p - 'a' + 10);
+        else if (*p >= 'A' && *p <= 'F')
+            digit = static_cast<unsigned>(*p - 'A' + 10);
+        else
+            return false;
+        value = (value << 4U) | digit;
+    }
+    *out = value;
+    return true;
+}
+
+// Drop compiler suffixes like "$..." or ".llvm.<hash>"
+std::string_view normalize_name(std::string_view name) {
+    size_t pos = name.find('$');
+    if (pos == std::string_view::npos)
+        pos = name.find(".llvm.");
+    return pos == std::string_view::npos ? name : name.substr(0, pos);
+}
+
+}  // namespace
+
+uint32_t Resolver::find(std::string_view name) const {
+    if (table_.empty())
+        return EMPTY;
+    const size_t mask = table_.size() - 1;
+    for (size_t bucket = hash_name(name) & mask;; bucket = (bucket + 1) & mask) {
+        const uint32_t slot = table_[bucket];
+        if (slot == EMPTY || names_[slot] == name)
+            return slot;
+    }
+}
+
+void Resolver::rehash(size_t buckets) {
+    table_.assign(buckets, EMPTY);
+    const size_t mask = buckets - 1;
+    for (uint32_t slot = 0; slot < names_.size(); ++slot) {
+        size_t bucket = hash_name(names_[slot]) & mask;
+        while (table_[bucket] != EMPTY)
+            bucket = (bucket + 1) & mask;
+        table_[bucket] = slot;
+    }
+}
+
+size_t Resolver::want(std::string_view name) {
+    const uint32_t existing = find(name);
+    if (existing != EMPTY)
+        return existing;
+
+    names_.push_back(name);
+    addresses_.push_back(0);
+    found_.push_back(0);
+    // Keep the table at most half full so probes stay short
+    if (names_.size() * 2 > table_.size()) {
+        size_t buckets = table_.empty() ? 64 : table_.size();
+        while (names_.size() * 2 > buckets)
+            buckets *= 2;
+        rehash(buckets);
+    } else {
+        const size_t mask = table_.size() - 1;
+        size_t bucket = hash_name(name) & mask;
+        while (table_[bucket] != EMPTY)
+            bucket = (bucket + 1) & mask;
+        table_[bucket] = static_cast<uint32_t>(names_.size() - 1);
+    }
+    return names_.size() - 1;
+}
+
+bool Resolver::consume_line(const char* begin, const char* end) {
+    ++stats_.lines;
+    // "<hex address> <type> <name>[\t[<module>]]"
+    const char* addr_end = static_cast<const char*>(memchr(begin, ' ', end - begin));
+    if (addr_end == nullptr || end - addr_end < 4 || addr_end[2] != ' ')
+        return true;
+    const char* name_begin = addr_end + 3;
+    const char* name_end = name_begin;
+    while (name_end != end && *name_end != '\t' && *name_end != ' ')
+        ++name_end;
+
+    // Kernel symbols come before module symbols. Stop once module-owned entries
+    // start so nothing is relocated against another module.
+    if (name_end != end)
+        return false;
+
+    const uint32_t slot = find(normalize_name(std::string_view(name_begin, name_end - name_begin)));
+    if (slot == EMPTY || found_[slot] != 0)
+        return true;
+    uint64_t addr = 0;
+    if (!parse_hex(begin, addr_end, &addr))
+        return true;
+    addresses_[slot] = addr;
+    found_[slot] = 1;
+    return ++found_count_ != names_.size();
+}
+
+bool Resolver::resolve(int fd) {
+    if (missing() == 0)
+        return true;
+
+    std::vector<char> buffer(READ_CHUNK);
+    size_t pending = 0;  // bytes of an unfinished line at the buffer start
+    while (true) {
+        if (pending == buffer.size())
+            buffer.resize(buffer.size() * 2);  // absurdly long line
+        const ssize_t count = read(fd, buffer.data() + pending, buffer.size() - pending);
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        stats_.bytes += static_cast<size_t>(count);
+        const char* data = buffer.data();
+        const char* end = data + pending + count;
+        if (count == 0) {
+            if (pending != 0)
+                (void)consume_line(data, end);
+            return true;
+        }
+
+        const char* line = data;
+        while (const char* nl = static_cast<const char*>(memchr(line, '\n', end - line))) {
+            if (!consume_line(line, nl))
+                return true;
+            line = nl + 1;
+        }
+        pending = static_cast<size_t>(end - line);
+        memmove(buffer.data(), line, pending);
+    }
+}
+
+bool Resolver::resolve(const char* path) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    const bool ok = resolve(fd);
+    close(fd);
+    return ok;
+}
+
+}  // namespace kallsyms
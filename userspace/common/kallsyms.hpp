@@ -0,0 +1,109 @@
+#pragma once
+
+#include <elf.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+// Targeted /proc/kallsyms lookup shared by ksuinit and ksud's LKM loader.
+// Only the names a module leaves undefined are wanted, so instead of mapping
+// every kernel symbol the text is streamed in large reads, parsed in place
+// and matched against a small open-addressed set; the scan stops as soon as
+// every wanted name has an address or module symbols begin.
+namespace kallsyms {
+
+struct ScanStats {
+    size_t bytes = 0;  // kallsyms bytes read
+    size_t lines = 0;  // lines parsed
+};
+
+class Resolver {
+public:
+    // Slot for name, shared by repeated names. The view must outlive resolve().
+    size_t want(std::string_view name);
+
+    // Stream kallsyms text from fd. First match wins, so the scan can end
+    // early; lines tagged with a [module] end it too. False on read error.
+    bool resolve(int fd);
+    // Same, opening path
+    bool resolve(const char* path);
+
+    [[nodiscard]] size_t size() const { return names_.size(); }
+    [[nodiscard]] size_t missing() const { return names_.size() - found_count_; }
+    [[nodiscard]] std::string_view name(size_t slot) const { return names_[slot]; }
+    [[nodiscard]] bool found(size_t slot) const { return found_[slot] != 0; }
+    [[nodiscard]] uint64_t address(size_t slot) const { return addresses_[slot]; }
+    [[nodiscard]] const ScanStats& stats() const { return stats_; }
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    [[nodiscard]] uint32_t find(std::string_view name) const;
+    void rehash(size_t buckets);
+    // Returns false once parsing should stop
+    bool consume_line(const char* begin, const char* end);
+
+    std::vector<std::string_view> names_;
+    std::vector<uint64_t> addresses_;
+    std::vector<uint8_t> found_;
+    std::vector<uint32_t> table_;  // slot per bucket, EMPTY when free
+    size_t found_count_ = 0;
+    ScanStats stats_;
+};
+
+// Undefined symbol of a relocatable ELF image, pointing into that image
+template <typename Sym>
+struct UndefinedSymbol {
+    Sym* sym;
+    std::string_view name;
+};
+
+// Collect the named SHN_UNDEF entries of image's symbol table. Returns
+// nullptr on success, otherwise a short reason.
+template <typename Ehdr, typename Shdr, typename Sym>
+const char* collect_undefined_symbols(uint8_t* image, size_t size,
+                                      std::vector<UndefinedSymbol<Sym>>* out) {
+    if (size < sizeof(Ehdr))
+        return "file too small to be an ELF";
+    auto* ehdr = reinterpret_cast<Ehdr*>(image);
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0)
+        return "invalid ELF magic";
+    if (ehdr->e_shoff > size || ehdr->e_shnum > (size - ehdr->e_shoff) / sizeof(Shdr))
+        return "section headers out of range";
+
+    auto* shdr_base = reinterpret_cast<Shdr*>(image + ehdr->e_shoff);
+    const Shdr* symtab = nullptr;
+    for (size_t i = 0; i < ehdr->e_shnum; ++i) {
+        if (shdr_base[i].sh_type == SHT_SYMTAB) {
+            symtab = &shdr_base[i];
+            break;
+        }
+    }
+    if (symtab == nullptr || symtab->sh_link >= ehdr->e_shnum)
+        return "cannot find symbol table";
+    const Shdr* strtab = &shdr_base[symtab->sh_link];
+    if (symtab->sh_offset > size || symtab->sh_size > size - symtab->sh_offset ||
+        strtab->sh_offset > size || strtab->sh_size > size - strtab->sh_offset) {
+        return "symbol table out of range";
+    }
+
+    auto* sym_base = reinterpret_cast<Sym*>(image + symtab->sh_offset);
+    const char* str_base = reinterpret_cast<const char*>(image + strtab->sh_offset);
+    const size_t str_size = strtab->sh_size;
+    const size_t sym_count = symtab->sh_size / sizeof(Sym);
+    for (size_t i = 1; i < sym_count; ++i) {
+        Sym* sym = &sym_base[i];
+        if (sym->st_shndx != SHN_UNDEF || sym->st_name == 0 || sym->st_name >= str_size)
+            continue;
+        const char* name = str_base + sym->st_name;
+        const size_t len = strnlen(name, str_size - sym->st_name);
+        if (len != 0)
+            out->push_back({sym, std::string_view(name, len)});
+    }
+    return nullptr;
+}
+
+}  // namespace kallsyms
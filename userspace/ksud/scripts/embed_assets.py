@@ -4,6 +4,7 @@ Generate C++ source file containing embedded binary assets.
 Compresses binaries with zlib for efficient storage.
 """
 
+import hashlib
 import sys
 import zlib
 from pathlib import Path
@@ -27,7 +28,7 @@ def normalize_asset_data(filepath: Path, data: bytes) -> bytes:
     return data
 
 
-def generate_asset_array(filepath: Path) -> tuple[str, str, int, int]:
+def generate_asset_array(filepath: Path) -> tuple[str, str, int, int, int]:
     """Generate C array for a single file."""
     name = to_c_identifier(filepath.name)
 
@@ -35,13 +36,14 @@ def generate_asset_array(filepath: Path) -> tuple[str, str, int, int]:
         data = normalize_asset_data(filepath, f.read())
 
     original_size = len(data)
+    content_hash = int.from_bytes(hashlib.sha256(data).digest()[:8], 'big')
     compressed_data = zlib.compress(data, level=9)
     compressed_size = len(compressed_data)
 
     # Generate hex array
     hex_data = ', '.join(f'0x{b:02x}' for b in compressed_data)
 
-    return name, hex_data, compressed_size, original_size
+    return name, hex_data, compressed_size, original_size, content_hash
 
 
 def main():
@@ -72,6 +74,7 @@ def main():
 #include <map>
 #include <sys/stat.h>
 #include <cerrno>
+#include <ctime>
 #include <unistd.h>
 #include <vector>
 #include <zlib.h>
@@ -83,7 +86,7 @@ namespace ksud {
     # Generate arrays for each asset
     asset_infos = []
     for filepath in assets:
-        name, hex_data, size, original_size = generate_asset_array(filepath)
+        name, hex_data, size, original_size, content_hash = generate_asset_array(filepath)
         output += f'// Asset: {filepath.name}\n'
         output += f'static const unsigned char asset_{name}[] = {{\n'
         
@@ -94,7 +97,8 @@ namespace ksud {
         
         output += f'}};\n'
         output += f'static const size_t asset_{name}_size = {size};\n'
-        output += f'static const size_t asset_{name}_original_size = {original_size};\n\n'
+        output += f'static const size_t asset_{name}_original_size = {original_size};\n'
+        output += f'static const uint64_t asset_{name}_hash = 0x{content_hash:016x}ULL;\n\n'
         
         asset_infos.append((filepath.name, name, size, original_size))
     
@@ -106,15 +110,16 @@ struct AssetEntry {
     const unsigned char* data;
     size_t size;
     size_t original_size;
+    uint64_t hash;  // sha256 prefix of the decompressed content
 };
 
 static const std::array<AssetEntry, ''' + str(n_entries) + '''> asset_registry = {{
 '''
     
     for filename, name, size, original_size in asset_infos:
-        output += f'    {{"{filename}", asset_{name}, asset_{name}_size, asset_{name}_original_size}},\n'
+        output += f'    {{"{filename}", asset_{name}, asset_{name}_size, asset_{name}_original_size, asset_{name}_hash}},\n'
     
-    output += '''    {nullptr, nullptr, 0, 0}  // sentinel
+    output += '''    {nullptr, nullptr, 0, 0, 0}  // sentinel
 }};
 
 const std::vector<std::string>& list_assets() {
@@ -142,6 +147,18 @@ bool get_asset(const std::string& name, const uint8_t*& data, size_t& size) {
     return false;
 }
 
+bool get_asset_stamp(const std::string& name, uint64_t& hash, size_t& original_size) {
+    for (const auto& entry : asset_registry) {
+        if (entry.name == nullptr) break;
+        if (name == entry.name) {
+            hash = entry.hash;
+            original_size = entry.original_size;
+            return true;
+        }
+    }
+    return false;
+}
+
 bool copy_asset_to_file(const std::string& name, const std::string& dest_path) {
     const AssetEntry* entry = nullptr;
     for (const auto& e : asset_registry) {
@@ -202,6 +219,19 @@ int ensure_binaries(bool ignore_if_exist) {
         return 1;
     }
     
+    // Rewrite only what is missing or stale. The manifest ties every file to
+    // the content hash it was extracted from, so a binary from an older build
+    // (different hash) or one replaced behind our back (different inode, size,
+    // mode or mtime) is still overwritten; ignore_if_exist is not needed.
+    (void)ignore_if_exist;
+    AssetManifest manifest(std::string(BINARY_DIR) + ".asset_manifest");
+    struct timespec start{};
+    struct timespec end{};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int written = 0;
+    int kept = 0;
+    size_t kept_bytes = 0;
+    
     for (const auto& name : list_assets()) {
         // Skip ksuinit and kernel modules - they are extracted on demand
         if (name == "ksuinit" || name.find("_kernelsu.ko") != std::string::npos ||
@@ -211,16 +241,30 @@ int ensure_binaries(bool ignore_if_exist) {
         }
         
         const std::string dest = std::string(BINARY_DIR) + name;
+        if (manifest.current(name, dest)) {
+            uint64_t hash = 0;
+            size_t size = 0;
+            (void)get_asset_stamp(name, hash, size);
+            kept++;
+            kept_bytes += size;
+            continue;
+        }
         
-        // Unconditionally overwrite so a stale binary from an older build is
-        // never left behind (copy_asset_to_file removes the dest first).
-        (void)ignore_if_exist;
         if (!copy_asset_to_file(name, dest)) {
             LOGE("Failed to extract binary: %s", name.c_str());
+            manifest.save();
             return 1;
         }
         chmod(dest.c_str(), 0755);
+        manifest.record(name, dest);
+        written++;
     }
+    manifest.save();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const long long elapsed_us = (end.tv_sec - start.tv_sec) * 1000000LL +
+                                 (end.tv_nsec - start.tv_nsec) / 1000;
+    LOGI("Binaries: %d extracted, %d unchanged (%zu bytes not rewritten) in %lld us",
+         written, kept, kept_bytes, elapsed_us);
     
     // Ensure the multi-call entries are symlinks to ksud -- NOT real files. A
     // real busybox/ksud binary (e.g. left by another manager or an older build)
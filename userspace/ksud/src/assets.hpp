@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <fstream>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -16,6 +17,37 @@ bool get_asset(const std::string& name, const uint8_t*& data, size_t& size);
 // Copy asset to file
 bool copy_asset_to_file(const std::string& name, const std::string& dest_path);
 
+// Content hash (sha256 prefix) and decompressed size of an embedded asset
+bool get_asset_stamp(const std::string& name, uint64_t& hash, size_t& original_size);
+
+// Sidecar record of extracted assets. Each destination keeps the content hash
+// it was written from plus the inode, size, mode and mtime it had afterwards,
+// so an unchanged file is recognised from one lstat() without decompressing.
+class AssetManifest {
+public:
+    explicit AssetManifest(std::string path);
+
+    // dest_path still holds exactly what asset name would extract to
+    bool current(const std::string& name, const std::string& dest_path) const;
+    // Remember dest_path as freshly extracted from asset name
+    void record(const std::string& name, const std::string& dest_path);
+    // Write the manifest back if anything changed
+    bool save();
+
+private:
+    struct Entry {
+        uint64_t hash = 0;
+        uint64_t size = 0;
+        uint64_t ino = 0;
+        uint32_t mode = 0;
+        int64_t mtime_ns = 0;
+    };
+
+    std::string path_;
+    std::map<std::string, Entry> entries_;
+    bool dirty_ = false;
+};
+
 // List supported KMI versions (extracted from embedded LKM names)
 std::vector<std::string> list_supported_kmi();
 
@@ -0,0 +1,257 @@
+#include "boot_timeline.hpp"
+#include "defs.hpp"
+#include "log.hpp"
+#include "utils.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace ksud {
+
+namespace {
+
+constexpr const char* TIMELINE_FILE = "boot_timeline.log";
+constexpr const char* TIMELINE_OLD_FILE = "boot_timeline.old.log";
+constexpr const char* BOOT_ID_PATH = "/proc/sys/kernel/random/boot_id";
+constexpr const char* BOOT_ID_PREFIX = "# boot_id ";
+constexpr const char* STAGE_TOTAL = "*";
+
+struct Span {
+    int64_t start_us = 0;
+    int64_t dur_us = 0;
+    int pid = 0;
+    std::string stage;
+    std::string name;
+};
+
+std::string timeline_path(bool previous) {
+    return std::string(LOG_DIR) + (previous ? TIMELINE_OLD_FILE : TIMELINE_FILE);
+}
+
+std::string current_boot_id() {
+    const auto id = read_file(BOOT_ID_PATH);
+    return id ? trim(*id) : std::string();
+}
+
+// Append fd for this boot's timeline, rotating a file left by another boot.
+// -1 when the log dir is unusable.
+int open_timeline() {
+    int fd = -1;
+    if (!ensure_dir_exists(LOG_DIR))
+        return fd;
+
+    const std::string path = timeline_path(false);
+    const std::string header = BOOT_ID_PREFIX + current_boot_id();
+    std::string first_line;
+    {
+        std::ifstream ifs(path);
+        std::getline(ifs, first_line);
+    }
+    if (first_line != header) {
+        (void)rename(path.c_str(), timeline_path(true).c_str());
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+        if (fd >= 0) {
+            const std::string line = header + "\n";
+            (void)write(fd, line.data(), line.size());
+            return fd;
+        }
+        if (errno != EEXIST) {
+            LOGW("Failed to create %s: %s", path.c_str(), strerror(errno));
+            return fd;
+        }
+        // Another stage process started this boot's file first.
+    }
+    fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    return fd;
+}
+
+// Opened once per process, also when the first spans come from several threads
+int timeline_fd() {
+    static const int fd = open_timeline();
+    return fd;
+}
+
+std::vector<Span> read_spans(const std::string& path, std::string& boot_id) {
+    std::vector<Span> spans;
+    std::ifstream ifs(path);
+    std::string line;
+    while (std::getline(ifs, line)) {
+        if (starts_with(line, BOOT_ID_PREFIX)) {
+            boot_id = line.substr(strlen(BOOT_ID_PREFIX));
+            continue;
+        }
+        Span s;
+        long long start = 0;
+        long long dur = 0;
+        char stage[64] = {};
+        int name_off = 0;
+        if (sscanf(line.c_str(), "%lld %lld %d %63s %n", &start, &dur, &s.pid, stage,
+                   &name_off) != 4 ||
+            name_off <= 0) {
+            continue;
+        }
+        s.start_us = start;
+        s.dur_us = dur;
+        s.stage = stage;
+        s.name = line.substr(static_cast<size_t>(name_off));
+        spans.push_back(std::move(s));
+    }
+    return spans;
+}
+
+std::string json_escape(const std::string& s) {
+    std::string out;
+    for (const char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+// Chrome trace "complete" events: one row per ksud process, stages nest.
+std::string chrome_trace(const std::vector<Span>& spans) {
+    std::ostringstream out;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& s : spans) {
+        out << (first ? "" : ",") << "{\"name\":\""
+            << json_escape(s.name == STAGE_TOTAL ? s.stage : s.name) << "\",\"cat\":\""
+            << json_escape(s.stage) << "\",\"ph\":\"X\",\"ts\":" << s.start_us
+            << ",\"dur\":" << s.dur_us << ",\"pid\":1,\"tid\":" << s.pid << "}";
+        first = false;
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+double to_ms(int64_t us) {
+    return static_cast<double>(us) / 1000.0;
+}
+
+}  // namespace
+
+int64_t timeline_now_us() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void timeline_record(const std::string& stage, const std::string& name, int64_t start_us,
+                     int64_t end_us) {
+    const int fd = timeline_fd();
+    if (fd < 0)
+        return;
+    std::string clean = name;
+    std::replace(clean.begin(), clean.end(), '\n', ' ');
+    char line[512];
+    const int n = snprintf(line, sizeof(line), "%lld %lld %d %s %s\n",
+                           static_cast<long long>(start_us),
+                           static_cast<long long>(end_us - start_us), getpid(), stage.c_str(),
+                           clean.c_str());
+    if (n <= 0)
+        return;
+    // One O_APPEND write per span keeps concurrent stage processes intact.
+    (void)write(fd, line, std::min<size_t>(static_cast<size_t>(n), sizeof(line) - 1));
+}
+
+TimelineStage::TimelineStage(std::string stage)
+    : stage_(std::move(stage)), stage_start_us_(timeline_now_us()) {}
+
+TimelineStage::~TimelineStage() {
+    const int64_t now = timeline_now_us();
+    close_step(now);
+    timeline_record(stage_, STAGE_TOTAL, stage_start_us_, now);
+}
+
+void TimelineStage::step(std::string name) {
+    const int64_t now = timeline_now_us();
+    close_step(now);
+    step_ = std::move(name);
+    step_start_us_ = now;
+}
+
+void TimelineStage::close_step(int64_t now) {
+    if (step_.empty())
+        return;
+    timeline_record(stage_, step_, step_start_us_, now);
+    step_.clear();
+}
+
+int debug_boot_timeline(const std::vector<std::string>& args) {
+    bool previous = false;
+    std::string chrome_out;
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--previous") {
+            previous = true;
+        } else if (args[i] == "--chrome" && i + 1 < args.size()) {
+            chrome_out = args[++i];
+        } else {
+            printf("Usage: ksud debug boot-timeline [--previous] [--chrome FILE|-]\n");
+            return 1;
+        }
+    }
+
+    const std::string path = timeline_path(previous);
+    std::string boot_id;
+    std::vector<Span> spans = read_spans(path, boot_id);
+    if (spans.empty()) {
+        printf("No boot timeline recorded at %s\n", path.c_str());
+        return 1;
+    }
+    std::sort(spans.begin(), spans.end(),
+              [](const Span& a, const Span& b) { return a.start_us < b.start_us; });
+
+    if (!chrome_out.empty()) {
+        const std::string trace = chrome_trace(spans);
+        if (chrome_out == "-") {
+            fputs(trace.c_str(), stdout);
+            return 0;
+        }
+        if (!write_file(chrome_out, trace)) {
+            printf("Failed to write %s: %s\n", chrome_out.c_str(), strerror(errno));
+            return 1;
+        }
+        printf("Wrote %zu spans to %s\n", spans.size(), chrome_out.c_str());
+        return 0;
+    }
+
+    printf("Boot timeline %s (boot_id %s)\n\n", path.c_str(),
+           boot_id.empty() ? "unknown" : boot_id.c_str());
+    printf("Stages:\n");
+    std::vector<const Span*> steps;
+    for (const auto& s : spans) {
+        if (s.name == STAGE_TOTAL) {
+            printf("  %-20s at %9.1fms  took %9.1fms  (pid %d)\n", s.stage.c_str(),
+                   to_ms(s.start_us), to_ms(s.dur_us), s.pid);
+        } else {
+            steps.push_back(&s);
+        }
+    }
+
+    std::stable_sort(steps.begin(), steps.end(),
+                     [](const Span* a, const Span* b) { return a->dur_us > b->dur_us; });
+    printf("\nSteps by duration:\n");
+    for (const Span* s : steps) {
+        printf("  %9.1fms  %-20s %-32s at %9.1fms\n", to_ms(s->dur_us), s->stage.c_str(),
+               s->name.c_str(), to_ms(s->start_us));
+    }
+    return 0;
+}
+
+}  // namespace ksud
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ksud {
+
+// Per-boot span log (LOG_DIR/boot_timeline.log). Every ksud stage process
+// appends to the same file, one write() per span, stamped with CLOCK_BOOTTIME
+// so spans from different processes line up. A new boot rotates the previous
+// timeline to boot_timeline.old.log.
+
+// Microseconds since boot
+int64_t timeline_now_us();
+
+// Append one finished span
+void timeline_record(const std::string& stage, const std::string& name, int64_t start_us,
+                     int64_t end_us);
+
+// Records consecutive steps of one stage: step() closes the running step and
+// opens the next; destruction closes the last one and records the stage total.
+class TimelineStage {
+public:
+    explicit TimelineStage(std::string stage);
+    ~TimelineStage();
+    TimelineStage(const TimelineStage&) = delete;
+    TimelineStage& operator=(const TimelineStage&) = delete;
+
+    void step(std::string name);
+
+private:
+    void close_step(int64_t now);
+
+    std::string stage_;
+    std::string step_;
+    int64_t stage_start_us_;
+    int64_t step_start_us_ = 0;
+};
+
+// ksud debug boot-timeline [--previous] [--chrome FILE]
+int debug_boot_timeline(const std::vector<std::string>& args);
+
+}  // namespace ksud
@@ -1,6 +1,7 @@
 #include "cli.hpp"
 #include "assets.hpp"
 #include "boot/boot_patch.hpp"
+#include "boot_timeline.hpp"
 #include "core/feature.hpp"
 #include "core/hide_bootloader.hpp"
 #include "core/ksucalls.hpp"
@@ -333,6 +334,11 @@ int cmd_debug(const std::vector<std::string>& args) {
         printf("  version            Get kernel version\n");
         printf("  mark <get|mark|unmark|refresh> [PID]\n");
         printf("  sulogd             Launch sulog daemon now\n");
+        printf("  boot-timeline [--previous] [--chrome FILE|-]\n");
+        printf("  exec-bench [COUNT] [CMD...]  Time fork+exec against exec_command\n");
+        printf("  kallsyms-bench <KALLSYMS> <KO> [ROUNDS]  Time kallsyms symbol resolution\n");
+        printf("  restorecon-bench [DIR] [MODULES] [FILES] [ROUNDS]  Time restorecon on a "
+               "synthetic tree\n");
         return 1;
     }
 
@@ -353,6 +359,14 @@ int cmd_debug(const std::vector<std::string>& args) {
         return debug_mark(std::vector<std::string>(args.begin() + 1, args.end()));
     } else if (subcmd == "sulogd") {
         return ensure_sulogd_running();
+    } else if (subcmd == "boot-timeline") {
+        return debug_boot_timeline(std::vector<std::string>(args.begin() + 1, args.end()));
+    } else if (subcmd == "exec-bench") {
+        return debug_exec_bench(std::vector<std::string>(args.begin() + 1, args.end()));
+    } else if (subcmd == "kallsyms-bench") {
+        return debug_kallsyms_bench(std::vector<std::string>(args.begin() + 1, args.end()));
+    } else if (subcmd == "restorecon-bench") {
+        return debug_restorecon_bench(std::vector<std::string>(args.begin() + 1, args.end()));
     }
 
     printf("Unknown debug subcommand: %s\n", subcmd.c_str());
@@ -2,8 +2,15 @@
 #include "restorecon.hpp"
 
 #include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
 #include <filesystem>
+#include <sstream>
 #include <string>
+#include <utility>
 
 #include "../defs.hpp"
 #include "../log.hpp"
@@ -11,6 +18,92 @@
 
 namespace ksud {
 
+namespace {
+
+constexpr const char* kManifestHeader = "asset-manifest v1";
+
+int64_t mtime_ns_of(const struct stat& st) {
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+}  // namespace
+
+AssetManifest::AssetManifest(std::string path) : path_(std::move(path)) {
+    auto content = read_file(path_);
+    if (!content)
+        return;
+    std::istringstream in(*content);
+    std::string line;
+    if (!std::getline(in, line) || line != kManifestHeader)
+        return;  // unknown format: everything is rewritten once
+    while (std::getline(in, line)) {
+        Entry e;
+        char dest[512] = {};
+        if (sscanf(line.c_str(),
+                   "%" SCNx64 " %" SCNu64 " %" SCNu64 " %" SCNo32 " %" SCNd64 " %511s", &e.hash,
+                   &e.size, &e.ino, &e.mode, &e.mtime_ns, dest) == 6) {
+            entries_[dest] = e;
+        }
+    }
+}
+
+bool AssetManifest::current(const std::string& name, const std::string& dest_path) const {
+    uint64_t hash = 0;
+    size_t size = 0;
+    if (!get_asset_stamp(name, hash, size))
+        return false;
+    auto it = entries_.find(dest_path);
+    if (it == entries_.end() || it->second.hash != hash)
+        return false;
+    struct stat st{};
+    if (lstat(dest_path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+    const Entry& e = it->second;
+    return static_cast<uint64_t>(st.st_size) == size && e.size == size &&
+           static_cast<uint64_t>(st.st_ino) == e.ino && (st.st_mode & 07777) == e.mode &&
+           mtime_ns_of(st) == e.mtime_ns;
+}
+
+void AssetManifest::record(const std::string& name, const std::string& dest_path) {
+    uint64_t hash = 0;
+    size_t size = 0;
+    struct stat st{};
+    if (!get_asset_stamp(name, hash, size) || lstat(dest_path.c_str(), &st) != 0) {
+        if (entries_.erase(dest_path) != 0)
+            dirty_ = true;
+        return;
+    }
+    Entry& e = entries_[dest_path];
+    e.hash = hash;
+    e.size = static_cast<uint64_t>(st.st_size);
+    e.ino = static_cast<uint64_t>(st.st_ino);
+    e.mode = st.st_mode & 07777;
+    e.mtime_ns = mtime_ns_of(st);
+    dirty_ = true;
+}
+
+bool AssetManifest::save() {
+    if (!dirty_)
+        return true;
+    std::string out = std::string(kManifestHeader) + "\n";
+    char line[640];
+    for (const auto& [dest, e] : entries_) {
+        snprintf(line, sizeof(line),
+                 "%016" PRIx64 " %" PRIu64 " %" PRIu64 " %" PRIo32 " %" PRId64 " %s\n", e.hash,
+                 e.size, e.ino, e.mode, e.mtime_ns, dest.c_str());
+        out += line;
+    }
+    // Replace atomically so a crash mid-write never vouches for a stale file.
+    const std::string tmp = path_ + ".tmp";
+    if (!write_file(tmp, out) || rename(tmp.c_str(), path_.c_str()) != 0) {
+        LOGW("Failed to write asset manifest %s: %s", path_.c_str(), strerror(errno));
+        unlink(tmp.c_str());
+        return false;
+    }
+    dirty_ = false;
+    return true;
+}
+
 // Hand-written asset helpers.
 // Stage YukiZygisk payloads when embedded.
 int ensure_yukizygisk(bool ignore_if_exist) {
@@ -124,7 +124,9 @@ int ksuctl(int request, void* arg) {
 
     const int ret = ioctl(fd, request, arg);
     if (ret < 0) {
-        LOGE("ioctl failed: request=0x%x, errno=%d (%s)", request, errno, strerror(errno));
+        const int err = errno;
+        LOGE("ioctl failed: request=0x%x, errno=%d (%s)", request, err, strerror(err));
+        errno = err;  // callers pick fallbacks by errno
         return -1;
     }
 
@@ -1,11 +1,29 @@
 #include "restorecon.hpp"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
 #include <sys/xattr.h>
+#include <unistd.h>
+#include <algorithm>
 #include <array>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <utility>
 #include <vector>
 #include "../defs.hpp"
 #include "../log.hpp"
+#include "../utils.hpp"
 
 namespace fs = std::filesystem;
 
@@ -55,26 +73,340 @@ bool restore_syscon(const fs::path& dir) {
     return true;
 }
 
-bool restore_syscon_if_unlabeled(const fs::path& dir) {
-    if (!fs::exists(dir)) {
+namespace {
+
+// Directories verified by earlier walks, keyed by path. Adding, removing or
+// renaming an entry moves its directory's ctime, so a directory whose stamp
+// still matches is not listed again; its known subdirectories are stamped on
+// their own. Relabelling a file in place only moves that file's ctime, so the
+// stamp cannot see it: the whole manifest is dropped when the build
+// fingerprint or kernel release changes, and every few boots regardless.
+constexpr const char* RESTORECON_MANIFEST = "/data/adb/ksu/.restorecon_manifest";
+constexpr const char* RESTORECON_MANIFEST_HEADER = "restorecon-manifest v2";
+constexpr const char* BOOT_ID_PATH = "/proc/sys/kernel/random/boot_id";
+constexpr uint32_t RESTORECON_FULL_WALK_BOOTS = 8;
+constexpr size_t RESTORECON_WORKERS = 4;
+
+struct DirStamp {
+    uint64_t dev = 0;
+    uint64_t ino = 0;
+    int64_t ctime_ns = 0;
+
+    bool operator==(const DirStamp& o) const {
+        return dev == o.dev && ino == o.ino && ctime_ns == o.ctime_ns;
+    }
+};
+
+using DirManifest = std::map<std::string, DirStamp>;
+
+struct Manifest {
+    std::string build;    // fingerprint and kernel release it was built under
+    std::string boot_id;  // boot that last wrote it
+    uint32_t boots = 0;   // boots since the last full walk
+    DirManifest dirs;
+};
+
+DirStamp stamp_of(const struct stat& st) {
+    return {static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino),
+            static_cast<int64_t>(st.st_ctim.tv_sec) * 1000000000LL + st.st_ctim.tv_nsec};
+}
+
+bool under(const std::string& path, const std::string& root) {
+    return path == root ||
+           (path.size() > root.size() && path.compare(0, root.size(), root) == 0 &&
+            (root.back() == '/' || path[root.size()] == '/'));
+}
+
+std::string parent_of(const std::string& path) {
+    const size_t slash = path.find_last_of('/');
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+std::string join_path(const std::string& dir, const char* name) {
+    return dir.back() == '/' ? dir + name : dir + "/" + name;
+}
+
+std::string build_key() {
+    struct utsname uts{};
+    const std::string release = uname(&uts) == 0 ? uts.release : "";
+    return getprop("ro.build.fingerprint").value_or("") + "|" + release;
+}
+
+Manifest load_manifest(const std::string& manifest_path) {
+    Manifest m;
+    m.build = build_key();
+    const auto boot_id = read_file(BOOT_ID_PATH);
+    m.boot_id = boot_id ? trim(*boot_id) : std::string();
+
+    auto content = read_file(manifest_path);
+    if (!content)
+        return m;
+    std::istringstream in(*content);
+    std::string line;
+    std::string build;
+    std::string last_boot;
+    if (!std::getline(in, line) || line != RESTORECON_MANIFEST_HEADER ||
+        !std::getline(in, build) || !std::getline(in, last_boot) ||
+        !std::getline(in, line) || !parse_uint32(line, &m.boots)) {
+        m.boots = 0;
+        return m;
+    }
+    if (build != m.build) {
+        LOGI("restorecon: build changed, dropping manifest");
+        m.boots = 0;
+        return m;
+    }
+    if (last_boot != m.boot_id && ++m.boots >= RESTORECON_FULL_WALK_BOOTS) {
+        LOGI("restorecon: %u boots since the last full walk, dropping manifest", m.boots);
+        m.boots = 0;
+        return m;
+    }
+    while (std::getline(in, line)) {
+        DirStamp st;
+        int off = 0;
+        if (sscanf(line.c_str(), "%" SCNu64 " %" SCNu64 " %" SCNd64 " %n", &st.dev, &st.ino,
+                   &st.ctime_ns, &off) == 3 &&
+            off > 0 && static_cast<size_t>(off) < line.size()) {
+            m.dirs[line.substr(static_cast<size_t>(off))] = st;
+        }
+    }
+    return m;
+}
+
+void save_manifest(const std::string& manifest_path, const Manifest& m) {
+    std::string out = std::string(RESTORECON_MANIFEST_HEADER) + "\n" + m.build + "\n" +
+                      m.boot_id + "\n" + std::to_string(m.boots) + "\n";
+    char buf[96];
+    for (const auto& [path, st] : m.dirs) {
+        snprintf(buf, sizeof(buf), "%" PRIu64 " %" PRIu64 " %" PRId64 " ", st.dev, st.ino,
+                 st.ctime_ns);
+        out += buf;
+        out += path;
+        out += '\n';
+    }
+    const std::string tmp = manifest_path + ".tmp";
+    if (!write_file(tmp, out) || rename(tmp.c_str(), manifest_path.c_str()) != 0) {
+        LOGW("Failed to write %s: %s", manifest_path.c_str(), strerror(errno));
+        unlink(tmp.c_str());
+    }
+}
+
+bool unlabeled(const char* con, ssize_t len) {
+    return len <= 0 || strcmp(con, UNLABEL_CON) == 0;
+}
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Shared breadth-first work list; workers stop once it is empty and idle.
+class DirQueue {
+public:
+    void push(std::string path) {
+        {
+            const std::lock_guard<std::mutex> lock(mu_);
+            pending_.push_back(std::move(path));
+        }
+        cv_.notify_one();
+    }
+
+    bool pop(std::string& out) {
+        std::unique_lock<std::mutex> lock(mu_);
+        cv_.wait(lock, [this] { return !pending_.empty() || active_ == 0; });
+        if (pending_.empty())
+            return false;
+        out = std::move(pending_.back());
+        pending_.pop_back();
+        active_++;
         return true;
     }
 
-    std::error_code ec;
-    for (auto it = fs::recursive_directory_iterator(dir, ec);
-         it != fs::recursive_directory_iterator() && !ec; it.increment(ec)) {
-        const std::string con = lgetfilecon(it->path());
-        if (con.empty() || con == UNLABEL_CON) {
-            if (!lsetfilecon(it->path(), SYSTEM_CON)) {
-                LOGW("Failed to restore context for %s", it->path().c_str());
+    void done() {
+        const std::lock_guard<std::mutex> lock(mu_);
+        if (--active_ == 0 && pending_.empty())
+            cv_.notify_all();
+    }
+
+private:
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::vector<std::string> pending_;
+    size_t active_ = 0;
+};
+
+struct WalkResult {
+    std::vector<std::pair<std::string, DirStamp>> verified;
+    std::vector<std::string> failed;  // could not be opened or listed
+    RestoreconStats stats;
+};
+
+void relabel_if_unlabeled(const std::string& path, RestoreconStats& stats) {
+    std::array<char, 256> con{};
+    const ssize_t len = lgetxattr(path.c_str(), SELINUX_XATTR, con.data(), con.size() - 1);
+    stats.checked++;
+    if (!unlabeled(con.data(), len))
+        return;
+    if (lsetfilecon(path, SYSTEM_CON))
+        stats.relabeled++;
+    else
+        LOGW("Failed to restore context for %s", path.c_str());
+}
+
+// Verify one directory: skip it when its stamp matches, otherwise list it with
+// getdents64 and check every entry. Subdirectories go back on the queue; the
+// walk root's own label is left alone, as the old iterator never visited it.
+void visit_dir(const std::string& path, bool is_root, const DirManifest& old, DirQueue& queue,
+               WalkResult& out) {
+    struct stat st{};
+    if (fstatat(AT_FDCWD, path.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISDIR(st.st_mode)) {
+        out.failed.push_back(path);
+        return;
+    }
+    const auto known = old.find(path);
+    if (known != old.end() && known->second == stamp_of(st)) {
+        out.stats.unchanged++;
+        out.verified.emplace_back(path, known->second);
+        const std::string prefix = path.back() == '/' ? path : path + "/";
+        for (auto it = old.lower_bound(prefix); it != old.end() && under(it->first, prefix);
+             ++it) {
+            if (it->first.find('/', prefix.size()) == std::string::npos)
+                queue.push(it->first);
+        }
+        return;
+    }
+
+    const int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        out.failed.push_back(path);
+        return;
+    }
+    out.stats.scanned++;
+    if (!is_root) {
+        std::array<char, 256> con{};
+        const ssize_t len = fgetxattr(fd, SELINUX_XATTR, con.data(), con.size() - 1);
+        out.stats.checked++;
+        if (unlabeled(con.data(), len)) {
+            if (fsetxattr(fd, SELINUX_XATTR, SYSTEM_CON, strlen(SYSTEM_CON) + 1, 0) == 0)
+                out.stats.relabeled++;
+            else
+                LOGW("Failed to restore context for %s: %s", path.c_str(), strerror(errno));
+        }
+    }
+
+    bool complete = true;
+    alignas(linux_dirent64) std::array<char, 16384> buf{};
+    for (;;) {
+        const long n = syscall(SYS_getdents64, fd, buf.data(), buf.size());
+        if (n < 0) {
+            LOGE("Error listing %s: %s", path.c_str(), strerror(errno));
+            complete = false;
+            break;
+        }
+        if (n == 0)
+            break;
+        for (long off = 0; off < n;) {
+            const auto* d = reinterpret_cast<const linux_dirent64*>(buf.data() + off);
+            off += d->d_reclen;
+            if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+                continue;
+            std::string child = join_path(path, d->d_name);
+            unsigned char type = d->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat cst{};
+                if (fstatat(fd, d->d_name, &cst, AT_SYMLINK_NOFOLLOW) == 0)
+                    type = S_ISDIR(cst.st_mode) ? DT_DIR : DT_REG;
             }
+            if (type == DT_DIR)
+                queue.push(std::move(child));  // labelled by its own visit
+            else
+                relabel_if_unlabeled(child, out.stats);
         }
     }
-    if (ec) {
-        LOGE("Error walking directory %s: %s", dir.c_str(), ec.message().c_str());
-        return false;
+
+    // Stamp after any relabel of the directory itself, which moves its ctime.
+    if (complete && fstat(fd, &st) == 0)
+        out.verified.emplace_back(path, stamp_of(st));
+    close(fd);
+}
+
+}  // namespace
+
+bool restore_syscon_if_unlabeled(const fs::path& dir, const std::string& manifest_path,
+                                 RestoreconStats* stats) {
+    if (!fs::exists(dir)) {
+        return true;
     }
-    return true;
+
+    struct timespec start{};
+    struct timespec end{};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    std::string root = dir.string();
+    while (root.size() > 1 && root.back() == '/')
+        root.pop_back();
+    Manifest loaded = load_manifest(manifest_path);
+    DirManifest& manifest = loaded.dirs;
+
+    // Walk in parallel so large module trees are listed concurrently.
+    DirQueue queue;
+    queue.push(root);
+    const size_t workers = std::max<size_t>(
+        1, std::min<size_t>(RESTORECON_WORKERS, std::thread::hardware_concurrency()));
+    std::vector<WalkResult> results(workers);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < workers; ++i) {
+        threads.emplace_back([&, i] {
+            std::string path;
+            while (queue.pop(path)) {
+                visit_dir(path, path == root, manifest, queue, results[i]);
+                queue.done();
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    // Replace everything under root with this walk. A directory holding one
+    // that could not be listed stays unverified so it is walked again.
+    for (auto it = manifest.begin(); it != manifest.end();) {
+        it = under(it->first, root) ? manifest.erase(it) : std::next(it);
+    }
+    RestoreconStats total;
+    std::set<std::string> incomplete;
+    for (auto& r : results) {
+        for (auto& [path, st] : r.verified)
+            manifest[path] = st;
+        for (const auto& path : r.failed) {
+            if (path != root)
+                incomplete.insert(parent_of(path));
+        }
+        total.scanned += r.stats.scanned;
+        total.unchanged += r.stats.unchanged;
+        total.checked += r.stats.checked;
+        total.relabeled += r.stats.relabeled;
+    }
+    for (const auto& path : incomplete)
+        manifest.erase(path);
+    save_manifest(manifest_path, loaded);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const long long elapsed_ms =
+        (end.tv_sec - start.tv_sec) * 1000LL + (end.tv_nsec - start.tv_nsec) / 1000000;
+    LOGI("restorecon %s: %zu dirs listed, %zu unchanged, %zu labels read, %zu relabeled in "
+         "%lldms",
+         root.c_str(), total.scanned, total.unchanged, total.checked, total.relabeled,
+         elapsed_ms);
+    if (stats != nullptr)
+        *stats = total;
+    return incomplete.empty();
+}
+
+bool restore_syscon_if_unlabeled(const fs::path& dir) {
+    return restore_syscon_if_unlabeled(dir, RESTORECON_MANIFEST, nullptr);
 }
 
 bool restorecon() {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <filesystem>
 #include <string>
 
@@ -23,9 +24,20 @@ bool setsyscon(const std::filesystem::path& path);
 // Restore system context for directory recursively
 bool restore_syscon(const std::filesystem::path& dir);
 
+struct RestoreconStats {
+    size_t scanned = 0;    // directories listed
+    size_t unchanged = 0;  // directories skipped by stamp
+    size_t checked = 0;    // entries whose label was read
+    size_t relabeled = 0;
+};
+
 // Restore system context if unlabeled
 bool restore_syscon_if_unlabeled(const std::filesystem::path& dir);
 
+// Same, tracking verified directories in manifest_path instead of the default
+bool restore_syscon_if_unlabeled(const std::filesystem::path& dir,
+                                 const std::string& manifest_path, RestoreconStats* stats);
+
 // Restore contexts for KSU files
 bool restorecon();
 
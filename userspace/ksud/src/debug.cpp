@@ -1,15 +1,28 @@
 #include "debug.hpp"
 #include "core/ksucalls.hpp"
+#include "core/restorecon.hpp"
 #include "kernelsu_loader.hpp"
 #include "log.hpp"
 #include "utils.hpp"
+#include "userspace/common/kallsyms.hpp"
 
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
 #include <cerrno>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 
 namespace ksud {
 
@@ -46,6 +59,67 @@ bool get_pkg_uid(const std::string& pkg, uint32_t& uid) {
     return true;
 }
 
+// What exec_command() did before it moved to vfork(): fork, exec, read both
+// pipes to EOF, reap.
+int fork_exec_capture(const std::vector<std::string>& args) {
+    std::array<int, 2> out{};
+    std::array<int, 2> err{};
+    if (pipe(out.data()) != 0 || pipe(err.data()) != 0)
+        return -1;
+    std::vector<char*> c_args;
+    for (const auto& arg : args)
+        c_args.push_back(const_cast<char*>(arg.c_str()));
+    c_args.push_back(nullptr);
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        dup2(out[1], STDOUT_FILENO);
+        dup2(err[1], STDERR_FILENO);
+        close(out[0]);
+        close(out[1]);
+        close(err[0]);
+        close(err[1]);
+        execvp(c_args[0], c_args.data());
+        _exit(127);
+    }
+    close(out[1]);
+    close(err[1]);
+    std::array<char, 1024> buf{};
+    std::string sink;
+    for (const int fd : {out[0], err[0]}) {
+        ssize_t n;
+        while ((n = read(fd, buf.data(), buf.size())) > 0)
+            sink.append(buf.data(), static_cast<size_t>(n));
+        close(fd);
+    }
+    int status = 0;
+    if (pid > 0)
+        waitpid(pid, &status, 0);
+    return pid > 0 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// What the loaders did before the targeted resolver: every symbol into a map
+std::unordered_map<std::string, uint64_t> full_kallsyms_map(const std::string& path) {
+    std::unordered_map<std::string, uint64_t> symbols;
+    std::ifstream ifs(path);
+    std::string line;
+    while (std::getline(ifs, line)) {
+        std::istringstream iss(line);
+        std::string addr;
+        std::string type;
+        std::string name;
+        if (!(iss >> addr >> type >> name))
+            continue;
+        size_t pos = name.find('$');
+        if (pos == std::string::npos)
+            pos = name.find(".llvm.");
+        if (pos != std::string::npos)
+            name.resize(pos);
+        symbols.emplace(name, strtoull(addr.c_str(), nullptr, 16));
+    }
+    return symbols;
+}
+
 }  // namespace
 
 int debug_set_manager(const std::string& pkg) {
@@ -160,4 +234,211 @@ int debug_mark(const std::vector<std::string>& args) {
     return 1;
 }
 
+int debug_exec_bench(const std::vector<std::string>& args) {
+    uint32_t count = 200;
+    if (!args.empty() && !parse_uint32(args[0], &count)) {
+        printf("Usage: ksud debug exec-bench [COUNT] [CMD...]\n");
+        return 1;
+    }
+    count = std::max<uint32_t>(count, 1);
+    std::vector<std::string> cmd(args.size() > 1 ? args.begin() + 1 : args.end(), args.end());
+    if (cmd.empty())
+        cmd = {"true"};
+
+    using clock = std::chrono::steady_clock;
+    const auto per_run_us = [count](clock::duration d) {
+        return static_cast<double>(
+                   std::chrono::duration_cast<std::chrono::microseconds>(d).count()) /
+               count;
+    };
+
+    int failures = 0;
+    auto start = clock::now();
+    for (uint32_t i = 0; i < count; ++i)
+        failures += fork_exec_capture(cmd) != 0;
+    const double fork_us = per_run_us(clock::now() - start);
+
+    start = clock::now();
+    for (uint32_t i = 0; i < count; ++i)
+        failures += exec_command(cmd).exit_code != 0;
+    const double spawn_us = per_run_us(clock::now() - start);
+
+    const long rss_kb = [] {
+        const auto status = read_file("/proc/self/status");
+        const size_t pos = status ? status->find("VmRSS:") : std::string::npos;
+        return pos == std::string::npos ? -1L : strtol(status->c_str() + pos + 6, nullptr, 10);
+    }();
+    printf("%s x%u (ksud VmRSS %ld kB)\n", cmd[0].c_str(), count, rss_kb);
+    printf("  fork+exec     %9.1f us/run\n", fork_us);
+    printf("  exec_command  %9.1f us/run\n", spawn_us);
+    if (failures != 0)
+        printf("  %d run(s) did not exit 0\n", failures);
+    return 0;
+}
+
+int debug_kallsyms_bench(const std::vector<std::string>& args) {
+    uint32_t rounds = 20;
+    if (args.size() < 2 || (args.size() > 2 && !parse_uint32(args[2], &rounds))) {
+        printf("Usage: ksud debug kallsyms-bench <KALLSYMS> <MODULE.ko> [ROUNDS]\n");
+        return 1;
+    }
+    rounds = std::max<uint32_t>(rounds, 1);
+    const std::string& kallsyms_path = args[0];
+
+    const auto image_text = read_file(args[1]);
+    if (!image_text) {
+        printf("Cannot read %s\n", args[1].c_str());
+        return 1;
+    }
+    std::vector<uint8_t> image(image_text->begin(), image_text->end());
+    std::vector<kallsyms::UndefinedSymbol<Elf64_Sym>> undefined;
+    const char* error = kallsyms::collect_undefined_symbols<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>(
+        image.data(), image.size(), &undefined);
+    if (error != nullptr) {
+        printf("%s: %s (64-bit modules only)\n", args[1].c_str(), error);
+        return 1;
+    }
+
+    using clock = std::chrono::steady_clock;
+    const auto per_round_ms = [rounds](clock::duration d) {
+        return static_cast<double>(
+                   std::chrono::duration_cast<std::chrono::microseconds>(d).count()) /
+               1000.0 / rounds;
+    };
+
+    size_t map_size = 0;
+    auto start = clock::now();
+    for (uint32_t i = 0; i < rounds; ++i)
+        map_size = full_kallsyms_map(kallsyms_path).size();
+    const double map_ms = per_round_ms(clock::now() - start);
+
+    kallsyms::Resolver resolver;
+    start = clock::now();
+    for (uint32_t i = 0; i < rounds; ++i) {
+        resolver = kallsyms::Resolver();
+        for (const auto& entry : undefined)
+            resolver.want(entry.name);
+        if (!resolver.resolve(kallsyms_path.c_str())) {
+            printf("Cannot read %s: %s\n", kallsyms_path.c_str(), strerror(errno));
+            return 1;
+        }
+    }
+    const double resolver_ms = per_round_ms(clock::now() - start);
+
+    // Both must agree on every name the module wants
+    const auto reference = full_kallsyms_map(kallsyms_path);
+    size_t mismatches = 0;
+    for (size_t slot = 0; slot < resolver.size(); ++slot) {
+        const auto it = reference.find(std::string(resolver.name(slot)));
+        const bool in_map = it != reference.end();
+        if (in_map != resolver.found(slot) || (in_map && it->second != resolver.address(slot)))
+            ++mismatches;
+    }
+
+    printf("%s: %zu wanted symbols, %zu missing, x%u\n", args[1].c_str(), resolver.size(),
+           resolver.missing(), rounds);
+    printf("  full map      %9.2f ms/round (%zu symbols)\n", map_ms, map_size);
+    printf("  targeted      %9.2f ms/round (%zu lines, %zu bytes read)\n", resolver_ms,
+           resolver.stats().lines, resolver.stats().bytes);
+    if (mismatches != 0)
+        printf("  %zu symbol(s) resolve differently (duplicate names or module symbols)\n",
+               mismatches);
+    return 0;
+}
+
+int debug_restorecon_bench(const std::vector<std::string>& args) {
+    std::string dir = "/data/local/tmp/restorecon-bench";
+    uint32_t modules = 40;
+    uint32_t files = 250;
+    uint32_t rounds = 10;
+    if ((args.size() > 1 && !parse_uint32(args[1], &modules)) ||
+        (args.size() > 2 && !parse_uint32(args[2], &files)) ||
+        (args.size() > 3 && !parse_uint32(args[3], &rounds))) {
+        printf("Usage: ksud debug restorecon-bench [DIR] [MODULES] [FILES] [ROUNDS]\n");
+        return 1;
+    }
+    if (!args.empty())
+        dir = args[0];
+    modules = std::max<uint32_t>(modules, 1);
+    rounds = std::max<uint32_t>(rounds, 1);
+    const std::string tree = dir + "/tree";
+    const std::string manifest = dir + "/manifest";
+
+    // Module-shaped tree: <tree>/mod_N/system/{lib64,etc,...}/dir_K with 25 files per dir
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    static constexpr std::array<const char*, 4> PARTS = {"lib64", "etc", "bin", "framework"};
+    std::string last_dir;
+    size_t total_dirs = 0;
+    size_t total_files = 0;
+    for (uint32_t m = 0; m < modules; ++m) {
+        for (uint32_t f = 0; f < files; ++f) {
+            if (f % 25 == 0) {
+                last_dir = tree + "/mod_" + std::to_string(m) + "/system/" +
+                           PARTS[(f / 25) % PARTS.size()] + "/dir_" + std::to_string(f / 25);
+                if (!std::filesystem::create_directories(last_dir, ec) && ec) {
+                    printf("Cannot create %s: %s\n", last_dir.c_str(), ec.message().c_str());
+                    return 1;
+                }
+                ++total_dirs;
+            }
+            if (!write_file(last_dir + "/f" + std::to_string(f), "x")) {
+                printf("Cannot write under %s: %s\n", last_dir.c_str(), strerror(errno));
+                return 1;
+            }
+            ++total_files;
+        }
+    }
+
+    using clock = std::chrono::steady_clock;
+    const auto ms_since = [](clock::time_point t) {
+        return static_cast<double>(
+                   std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - t)
+                       .count()) /
+               1000.0;
+    };
+
+    // What the walk used to cost: iterate everything, read every label
+    auto start = clock::now();
+    size_t legacy_reads = 0;
+    for (auto it = std::filesystem::recursive_directory_iterator(tree, ec);
+         it != std::filesystem::recursive_directory_iterator() && !ec; it.increment(ec)) {
+        std::array<char, 256> con{};
+        (void)lgetxattr(it->path().c_str(), "security.selinux", con.data(), con.size() - 1);
+        ++legacy_reads;
+    }
+    const double legacy_ms = ms_since(start);
+
+    RestoreconStats cold;
+    start = clock::now();
+    restore_syscon_if_unlabeled(tree, manifest, &cold);
+    const double cold_ms = ms_since(start);
+
+    RestoreconStats warm;
+    start = clock::now();
+    for (uint32_t i = 0; i < rounds; ++i)
+        restore_syscon_if_unlabeled(tree, manifest, &warm);
+    const double warm_ms = ms_since(start) / rounds;
+
+    (void)write_file(last_dir + "/added", "x");
+    RestoreconStats touched;
+    start = clock::now();
+    restore_syscon_if_unlabeled(tree, manifest, &touched);
+    const double touched_ms = ms_since(start);
+
+    std::filesystem::remove_all(dir, ec);
+
+    printf("%s: %u module(s), %zu dirs, %zu files\n", tree.c_str(), modules, total_dirs,
+           total_files);
+    printf("  iterator walk %9.2f ms (%zu labels read)\n", legacy_ms, legacy_reads);
+    const auto row = [](const char* name, double ms, const RestoreconStats& st) {
+        printf("  %-13s %9.2f ms (%zu listed, %zu unchanged, %zu labels read)\n", name, ms,
+               st.scanned, st.unchanged, st.checked);
+    };
+    row("cold manifest", cold_ms, cold);
+    row("unchanged", warm_ms, warm);
+    row("one new file", touched_ms, touched);
+    return 0;
+}
+
 }  // namespace ksud
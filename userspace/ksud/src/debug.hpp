@@ -8,5 +8,11 @@ namespace ksud {
 int debug_set_manager(const std::string& pkg);
 int debug_insmod(const std::string& module, const std::vector<std::string>& params);
 int debug_mark(const std::vector<std::string>& args);
+// ksud debug exec-bench [COUNT] [CMD...]: fork()+exec vs exec_command() timing
+int debug_exec_bench(const std::vector<std::string>& args);
+// ksud debug kallsyms-bench <KALLSYMS> <KO> [ROUNDS]: full kallsyms map vs targeted resolver
+int debug_kallsyms_bench(const std::vector<std::string>& args);
+// ksud debug restorecon-bench [DIR] [MODULES] [FILES] [ROUNDS]: manifest walk on a synthetic tree
+int debug_restorecon_bench(const std::vector<std::string>& args);
 
 }  // namespace ksud
@@ -76,6 +76,15 @@ constexpr const char* MODULE_CONFIG_DIR = "/data/adb/ksu/module_configs/";
 constexpr const char* PERSIST_CONFIG_NAME = "persist.config";
 constexpr const char* TEMP_CONFIG_NAME = "tmp.config";
 
+// Stage script scheduling: "jobs=N" (parallel module scripts, 1 = serial) and
+// "timeout=S" (per-script wall-clock budget in seconds, 0 = none).
+constexpr const char* STAGE_SCRIPTS_CONFIG = "/data/adb/ksu/.stage_scripts";
+constexpr int STAGE_SCRIPT_JOBS_DEFAULT = 4;
+constexpr int STAGE_SCRIPT_TIMEOUT_DEFAULT = 40;
+
+// Threads for the overlapped post-fs-data setup steps
+constexpr int POST_FS_DATA_SETUP_THREADS = 4;
+
 // Metamodule support
 constexpr const char* METAMODULE_MOUNT_SCRIPT = "metamount.sh";
 constexpr const char* METAMODULE_METAINSTALL_SCRIPT = "metainstall.sh";
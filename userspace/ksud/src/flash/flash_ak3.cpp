@@ -23,11 +23,9 @@
 
 #include "../log.hpp"
 #include "../utils.hpp"
+#include "../zip_reader.hpp"
 #include "flash_partition.hpp"
 
-#define MINIZ_HEADER_FILE_ONLY
-#include "miniz.h"
-
 namespace ksud::flash {
 
 namespace fs = std::filesystem;
@@ -124,71 +122,6 @@ private:
     FILE* file_;
 };
 
-class ZipReader {
-public:
-    explicit ZipReader(const std::string& path) : fd_(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
-        if (fd_ < 0) {
-            error_ = "Cannot open package: " + std::string(strerror(errno));
-            return;
-        }
-
-        struct stat stat_buffer{};
-        if (fstat(fd_, &stat_buffer) != 0 || !S_ISREG(stat_buffer.st_mode) ||
-            stat_buffer.st_size <= 0) {
-            error_ = "Package is not a non-empty regular file";
-            return;
-        }
-
-        archive_.m_pRead = &ZipReader::read_at;
-        archive_.m_pIO_opaque = this;
-        if (!mz_zip_reader_init(&archive_, static_cast<mz_uint64>(stat_buffer.st_size), 0)) {
-            error_ = std::string("Invalid ZIP archive: ") +
-                     mz_zip_get_error_string(mz_zip_get_last_error(&archive_));
-            return;
-        }
-        initialized_ = true;
-    }
-
-    ~ZipReader() {
-        if (initialized_)
-            mz_zip_reader_end(&archive_);
-        if (fd_ >= 0)
-            close(fd_);
-    }
-
-    ZipReader(const ZipReader&) = delete;
-    ZipReader& operator=(const ZipReader&) = delete;
-    ZipReader(ZipReader&&) = delete;
-    ZipReader& operator=(ZipReader&&) = delete;
-
-    [[nodiscard]] bool valid() const { return initialized_; }
-    [[nodiscard]] const std::string& error() const { return error_; }
-    mz_zip_archive* archive() { return &archive_; }
-
-private:
-    static size_t read_at(void* opaque, mz_uint64 offset, void* buffer, size_t size) {
-        auto* self = static_cast<ZipReader*>(opaque);
-        size_t total = 0;
-        while (total < size) {
-            const ssize_t count = pread(self->fd_, static_cast<char*>(buffer) + total, size - total,
-                                        static_cast<off_t>(offset + total));
-            if (count > 0) {
-                total += static_cast<size_t>(count);
-                continue;
-            }
-            if (count < 0 && errno == EINTR)
-                continue;
-            break;
-        }
-        return total;
-    }
-
-    int fd_ = -1;
-    bool initialized_ = false;
-    mz_zip_archive archive_{};
-    std::string error_;
-};
-
 std::string trim_copy(const std::string& value) {
     const auto first = value.find_first_not_of(" \t\r\n");
     if (first == std::string::npos)
@@ -1,5 +1,6 @@
 #include "init_event.hpp"
 #include "assets.hpp"
+#include "boot_timeline.hpp"
 #include "core/feature.hpp"
 #include "core/hide_bootloader.hpp"
 #include "core/ksucalls.hpp"
@@ -14,6 +15,7 @@
 #include "module/module_config.hpp"
 #include "profile/profile.hpp"
 #include "sulog.hpp"
+#include "task_graph.hpp"
 #include "umount.hpp"
 #include "utils.hpp"
 #include "yukizygisk_snapshot.hpp"
@@ -86,7 +88,7 @@ void catch_bootlog(const char* logname, const std::vector<const char*>& command)
     LOGI("Started %s capture (pid %d)", logname, pid);
 }
 
-void run_stage(const std::string& stage, bool block) {
+void run_stage(const std::string& stage, bool block, TimelineStage& timeline) {
     umask(0);
 
     // Check for Magisk (like Rust version)
@@ -101,12 +103,15 @@ void run_stage(const std::string& stage, bool block) {
     }
 
     // Execute common scripts first
+    timeline.step(stage + ".d");
     exec_common_scripts(stage + ".d", block);
 
     // Execute metamodule stage script (priority)
+    timeline.step("metamodule " + stage);
     metamodule_exec_stage_script(stage, block);
 
     // Execute regular modules stage scripts
+    timeline.step("modules " + stage);
     exec_stage_script(stage, block);
 }
 
@@ -232,6 +237,7 @@ void ensure_zygiskd_running_if_enabled() {
 
 int on_post_data_fs() {
     LOGI("post-fs-data triggered");
+    TimelineStage timeline("post-fs-data");
 
     if (!ensure_uapi_version_matched()) {
         LOGE("Skip post-fs-data due to UAPI version mismatch");
@@ -243,6 +249,7 @@ int on_post_data_fs() {
     }
 
     // Report to kernel first
+    timeline.step("report_post_fs_data");
     report_post_fs_data();
     load_and_apply_dynamic_managers();
 
@@ -252,6 +259,7 @@ int on_post_data_fs() {
     clear_all_temp_configs();
 
     // Catch boot logs
+    timeline.step("catch_bootlog");
     catch_bootlog("logcat", {"logcat", "-b", "all"});
     catch_bootlog("dmesg", {"dmesg", "-w"});
 
@@ -268,6 +276,7 @@ int on_post_data_fs() {
         LOGW("safe mode, skip common post-fs-data.d scripts");
     } else {
         // Execute common post-fs-data scripts
+        timeline.step("post-fs-data.d");
         exec_common_scripts("post-fs-data.d", true);
     }
 
@@ -277,45 +286,66 @@ int on_post_data_fs() {
     ensure_dir_exists(LOG_DIR);
     ensure_dir_exists(PROFILE_DIR);
 
-    // Ensure binaries exist (AFTER safe mode check, like Rust)
-    if (ensure_binaries(true) != 0) {
-        LOGW("Failed to ensure binaries");
-    }
-
     // if we are in safe mode, we should disable all modules
     if (safe_mode) {
+        // Ensure binaries exist (AFTER safe mode check, like Rust)
+        timeline.step("ensure_binaries");
+        if (ensure_binaries(true) != 0) {
+            LOGW("Failed to ensure binaries");
+        }
         LOGW("safe mode, skip post-fs-data scripts and disable all modules!");
         disable_all_modules();
         return 0;
     }
 
-    // Handle updated modules
-    handle_updated_modules();
-
-    // Prune modules marked for removal
-    prune_modules();
-
+    // Independent setup steps overlap; each waits only for what it reads.
+    // Everything that looks at the module set waits for updates and pruning,
+    // and every step that writes below /data/adb either finishes before
+    // restorecon, so its files are relabeled, or waits for it.
+    timeline.step("setup");
+    TaskGraph setup;
+    const size_t binaries = setup.add("ensure_binaries", [] {
+        if (ensure_binaries(true) != 0) {
+            LOGW("Failed to ensure binaries");
+        }
+    });
+    const size_t updated = setup.add("handle_updated_modules", [] { handle_updated_modules(); });
+    // uninstall.sh runs under busybox
+    const size_t pruned =
+        setup.add("prune_modules", [] { prune_modules(); }, {binaries, updated});
     // Refresh custom init rc for the next boot. This also covers manual edits in
     // /data/adb/initrc.d.
-    if (regenerate_preinit_rc() != 0) {
-        LOGW("regenerate preinit rc failed");
-    }
-
-    // Restorecon
-    restorecon("/data/adb", true);
-
-    // Load sepolicy rules from modules
-    load_sepolicy_rule();
-
-    // Apply profile sepolicies
-    apply_profile_sepolies();
-
+    const size_t preinit_rc = setup.add(
+        "regenerate_preinit_rc",
+        [] {
+            if (regenerate_preinit_rc() != 0) {
+                LOGW("regenerate preinit rc failed");
+            }
+        },
+        {pruned});
+    // Module rules first, then profile rules, one policy patch at a time
+    const size_t module_rules =
+        setup.add("load_sepolicy_rule", [] { load_sepolicy_rule(); }, {pruned});
+    setup.add("apply_profile_sepolies", [] { apply_profile_sepolies(); }, {module_rules});
     // Load feature config (with init_features handling managed features)
-    init_features();
-    ensure_yukizygisk_payload_if_enabled();
-    if (refresh_yukizygisk_early_snapshot() != 0) {
-        LOGW("refresh YukiZygisk early snapshot failed");
-    }
+    const size_t features = setup.add("init_features", [] { init_features(); }, {pruned});
+    const size_t relabeled = setup.add(
+        "restorecon", [] { restorecon("/data/adb", true); },
+        {binaries, pruned, preinit_rc, features});
+    const size_t payload = setup.add(
+        "yukizygisk_payload", [] { ensure_yukizygisk_payload_if_enabled(); },
+        {features, relabeled});
+    setup.add(
+        "yukizygisk_snapshot",
+        [] {
+            if (refresh_yukizygisk_early_snapshot() != 0) {
+                LOGW("refresh YukiZygisk early snapshot failed");
+            }
+        },
+        {payload});
+    setup.run("post-fs-data", POST_FS_DATA_SETUP_THREADS);
+
+    timeline.step("start_daemons");
     ensure_sulogd_running_if_enabled();
     ensure_zygiskd_running_if_enabled();
 
@@ -327,19 +357,25 @@ int on_post_data_fs() {
     // 5. Metamodule's metamount.sh  <-- MUST run AFTER all post-fs-data
     // 6. post-mount.d
 
+    timeline.step("metamodule post-fs-data");
     metamodule_exec_stage_script("post-fs-data", true);
+    timeline.step("modules post-fs-data");
     exec_stage_script("post-fs-data", true);
+    timeline.step("load_system_prop");
     load_system_prop();
 
     // Metamodule metamount runs AFTER all post-fs-data.
+    timeline.step("metamount");
     metamodule_exec_mount_script();
 
+    timeline.step("umount_apply_config");
     umount_apply_config();
 
     // Register per-app unmount only after umount_apply_config resets the list.
+    timeline.step("magisk_compat_su");
     mount_magisk_compat_su_if_enabled();
 
-    run_stage("post-mount", true);
+    run_stage("post-mount", true, timeline);
 
     chdir("/");
 
@@ -349,6 +385,7 @@ int on_post_data_fs() {
 
 void on_services() {
     LOGI("services triggered");
+    TimelineStage timeline("service");
 
     if (!ensure_uapi_version_matched()) {
         LOGE("Skip services due to UAPI version mismatch");
@@ -357,15 +394,17 @@ void on_services() {
 
     // Hide bootloader unlock status (soft BL hiding)
     // Service stage is the correct timing - after boot_completed is set
+    timeline.step("hide_bootloader_status");
     hide_bootloader_status();
 
-    run_stage("service", false);
+    run_stage("service", false, timeline);
 
     LOGI("services completed");
 }
 
 void on_boot_completed() {
     LOGI("boot-completed triggered");
+    TimelineStage timeline("boot-completed");
 
     if (!ensure_uapi_version_matched()) {
         LOGE("Skip boot-completed due to UAPI version mismatch");
@@ -373,12 +412,14 @@ void on_boot_completed() {
     }
 
     // Report to kernel
+    timeline.step("report_boot_complete");
     report_boot_complete();
 
+    timeline.step("msud");
     ensure_msud_running_if_enabled();
 
     // Run boot-completed stage
-    run_stage("boot-completed", false);
+    run_stage("boot-completed", false, timeline);
 
     LOGI("boot-completed completed");
 }
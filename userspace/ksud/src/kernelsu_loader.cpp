@@ -1,6 +1,7 @@
 #include "kernelsu_loader.hpp"
 
 #include "log.hpp"
+#include "userspace/common/kallsyms.hpp"
 
 #include <elf.h>
 #include <sys/syscall.h>
@@ -9,12 +10,10 @@
 #include <cerrno>
 #include <cstdint>
 #include <cstdio>
-#include <cstdlib>
 #include <cstring>
 #include <fstream>
-#include <sstream>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 namespace ksud::kernelsu_loader {
@@ -53,16 +52,6 @@ private:
     std::string original_value_;
 };
 
-void normalize_symbol_name(std::string* name) {
-    size_t pos = name->find('$');
-    if (pos == std::string::npos) {
-        pos = name->find(".llvm.");
-    }
-    if (pos != std::string::npos) {
-        name->resize(pos);
-    }
-}
-
 bool read_file(const char* path, std::vector<uint8_t>* buffer) {
     std::ifstream ifs(path, std::ios::binary | std::ios::ate);
     if (!ifs.is_open()) {
@@ -88,109 +77,48 @@ int init_module_syscall(void* module_image, unsigned long len, const char* param
 
 template <typename Ehdr, typename Shdr, typename Sym>
 bool patch_undefined_symbols(std::vector<uint8_t>* buffer) {
-    if (buffer->size() < sizeof(Ehdr)) {
-        LOGE("loader: file too small to be an ELF");
-        return false;
-    }
-
-    auto* ehdr = reinterpret_cast<Ehdr*>(buffer->data());
-    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0) {
-        LOGE("loader: invalid ELF magic");
-        return false;
-    }
-
-    auto* shdr_base = reinterpret_cast<Shdr*>(buffer->data() + ehdr->e_shoff);
-    const Shdr* symtab = nullptr;
-    const Shdr* strtab = nullptr;
-
-    for (int i = 0; i < ehdr->e_shnum; ++i) {
-        auto* shdr = &shdr_base[i];
-        if (shdr->sh_type == SHT_SYMTAB) {
-            symtab = shdr;
-            strtab = &shdr_base[shdr->sh_link];
-            break;
-        }
-    }
-
-    if (symtab == nullptr || strtab == nullptr) {
-        LOGE("loader: cannot find symbol table");
+    std::vector<kallsyms::UndefinedSymbol<Sym>> undefined;
+    const char* error = kallsyms::collect_undefined_symbols<Ehdr, Shdr, Sym>(
+        buffer->data(), buffer->size(), &undefined);
+    if (error != nullptr) {
+        LOGE("loader: %s", error);
         return false;
     }
-
-    auto* sym_base = reinterpret_cast<Sym*>(buffer->data() + symtab->sh_offset);
-    auto* str_base = reinterpret_cast<char*>(buffer->data() + strtab->sh_offset);
-    const size_t sym_count = symtab->sh_size / sizeof(Sym);
-    std::unordered_map<std::string, std::vector<Sym*>> unresolved_symbols;
-
-    for (size_t i = 1; i < sym_count; ++i) {
-        auto* sym = &sym_base[i];
-        if (sym->st_shndx != SHN_UNDEF) {
-            continue;
-        }
-
-        const char* name = &str_base[sym->st_name];
-        if (name == nullptr || *name == '\0') {
-            continue;
-        }
-        unresolved_symbols[name].push_back(sym);
-    }
-
-    if (unresolved_symbols.empty()) {
+    if (undefined.empty()) {
         return true;
     }
 
-    KptrGuard const guard;
-    std::ifstream ifs("/proc/kallsyms");
-    if (!ifs.is_open()) {
-        LOGE("loader: cannot open /proc/kallsyms");
-        return false;
+    kallsyms::Resolver resolver;
+    std::vector<size_t> slots;
+    slots.reserve(undefined.size());
+    for (const auto& entry : undefined) {
+        slots.push_back(resolver.want(entry.name));
     }
 
-    std::string line;
-    while (!unresolved_symbols.empty() && std::getline(ifs, line)) {
-        std::istringstream iss(line);
-        std::string addr_str;
-        std::string type;
-        std::string name;
-        std::string module_name;
-        if (!(iss >> addr_str >> type >> name)) {
-            continue;
-        }
-
-        // Kernel symbols come before module symbols in /proc/kallsyms. Stop scanning once we
-        // reach module-owned entries so we don't accidentally relocate against them.
-        if (iss >> module_name) {
-            break;
+    {
+        KptrGuard const guard;
+        if (!resolver.resolve("/proc/kallsyms")) {
+            LOGE("loader: failed while reading /proc/kallsyms: %s", strerror(errno));
+            return false;
         }
+    }
+    LOGD("loader: resolved %zu/%zu symbols after %zu kallsyms lines (%zu bytes)",
+         resolver.size() - resolver.missing(), resolver.size(), resolver.stats().lines,
+         resolver.stats().bytes);
 
-        char* end = nullptr;
-        errno = 0;
-        uint64_t const addr = std::strtoull(addr_str.c_str(), &end, 16);
-        if (end == addr_str.c_str() || *end != '\0' || errno == ERANGE) {
-            continue;
-        }
-
-        normalize_symbol_name(&name);
-
-        const auto it = unresolved_symbols.find(name);
-        if (it == unresolved_symbols.end()) {
+    for (size_t i = 0; i < undefined.size(); ++i) {
+        if (!resolver.found(slots[i])) {
             continue;
         }
-
-        for (auto* sym : it->second) {
-            sym->st_shndx = SHN_ABS;
-            sym->st_value = static_cast<decltype(sym->st_value)>(addr);
+        undefined[i].sym->st_shndx = SHN_ABS;
+        undefined[i].sym->st_value =
+            static_cast<decltype(undefined[i].sym->st_value)>(resolver.address(slots[i]));
+    }
+    for (size_t slot = 0; slot < resolver.size(); ++slot) {
+        if (!resolver.found(slot)) {
+            const std::string_view name = resolver.name(slot);
+            LOGW("loader: cannot find symbol: %.*s", static_cast<int>(name.size()), name.data());
         }
-        unresolved_symbols.erase(it);
-    }
-
-    if (!ifs.eof() && ifs.fail()) {
-        LOGE("loader: failed while reading /proc/kallsyms");
-        return false;
-    }
-
-    for (const auto& [name, _] : unresolved_symbols) {
-        LOGW("loader: cannot find symbol: %s", name.c_str());
     }
 
     return true;
@@ -63,43 +63,13 @@ int run_script(const std::string& script, bool block, const std::string& module_
 
     LOGI("Running metamodule script: %s", script.c_str());
 
-    std::string busybox = BUSYBOX_PATH;
-    if (!file_exists(busybox)) {
-        LOGW("Busybox not found at %s, falling back to /system/bin/sh", BUSYBOX_PATH);
-        busybox = "/system/bin/sh";
-    }
-
-    std::string script_dir = script.substr(0, script.find_last_of('/'));
-    if (script_dir.empty()) {
-        script_dir = "/";
-    }
-
-    const CommonScriptEnv common_env = build_common_script_env();
-
-    const char* busybox_path = busybox.c_str();
-    const char* script_path = script.c_str();
-    const char* script_dir_path = script_dir.c_str();
-    const char* module_id_cstr = module_id.empty() ? nullptr : module_id.c_str();
-    const char* extra_env_name_cstr = extra_env_name;
-    const char* extra_env_value_cstr = extra_env_value;
-
-    const pid_t pid = fork();
-    if (pid == 0) {
-        setsid();
-        switch_cgroups();
-        chdir(script_dir_path);
-
-        apply_common_script_env(common_env, module_id_cstr, true);
-        if (extra_env_name_cstr != nullptr && extra_env_value_cstr != nullptr) {
-            setenv(extra_env_name_cstr, extra_env_value_cstr, 1);
-        }
-
-        execl(busybox_path, "sh", script_path, nullptr);
-        _exit(127);
+    std::string extra_env;
+    if (extra_env_name != nullptr && extra_env_value != nullptr) {
+        extra_env = std::string(extra_env_name) + "=" + extra_env_value;
     }
 
+    const pid_t pid = spawn_module_script(script, module_id, extra_env);
     if (pid < 0) {
-        LOGE("Failed to fork for script: %s", script.c_str());
         return -1;
     }
 
@@ -1,5 +1,6 @@
 #include "module.hpp"
 #include "../assets.hpp"
+#include "../boot_timeline.hpp"
 #include "../core/ksucalls.hpp"
 #include "../core/restorecon.hpp"
 #include "../defs.hpp"
@@ -7,16 +8,21 @@
 #include "../sepolicy/sepolicy.hpp"
 #include "../utils.hpp"
 #include "../yukizygisk_snapshot.hpp"
+#include "../zip_reader.hpp"
 #include "metamodule.hpp"
+#include "module_registry.hpp"
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <algorithm>
 #include <array>
 #include <cctype>
 #include <climits>
+#include <csignal>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
@@ -53,6 +59,8 @@ namespace {
 
 constexpr const char* INSTALLER_SCRIPT_NAME = "installer.sh";
 constexpr const char* METADATA_FILE_CON = "u:object_r:metadata_file:s0";
+// module.prop is a handful of key=value lines; anything larger is not one
+constexpr size_t MODULE_PROP_MAX_SIZE = 64 * 1024;
 
 // Escape special characters for JSON string
 std::string escape_json(const std::string& s) {
@@ -206,25 +214,6 @@ std::string resolve_module_icon_path(
     return icon_value;
 }
 
-std::map<std::string, std::string> parse_module_prop(const std::string& path) {
-    std::map<std::string, std::string> props;
-    std::ifstream ifs(path);
-    if (!ifs)
-        return props;
-
-    std::string line;
-    while (std::getline(ifs, line)) {
-        const size_t eq = line.find('=');
-        if (eq != std::string::npos) {
-            const std::string key = trim(line.substr(0, eq));
-            const std::string value = trim(line.substr(eq + 1));
-            props[key] = value;
-        }
-    }
-
-    return props;
-}
-
 // Validate module ID like official ksud: ^[a-zA-Z][a-zA-Z0-9._-]+$
 bool validate_module_id(const std::string& id) {
     if (id.size() < 2) {
@@ -243,15 +232,6 @@ bool validate_module_id(const std::string& id) {
     return std::all_of(id.begin(), id.end(), is_valid_char);
 }
 
-// Check if module is metamodule
-bool is_metamodule(const std::map<std::string, std::string>& props) {
-    auto it = props.find("metamodule");
-    if (it == props.end())
-        return false;
-    const std::string val = it->second;
-    return val == "1" || val == "true" || val == "TRUE";
-}
-
 std::string get_metamodule_path_impl() {
     const std::string link_path =
         std::string(METAMODULE_DIR).substr(0, std::string(METAMODULE_DIR).length() - 1);
@@ -275,29 +255,11 @@ std::string get_metamodule_path_impl() {
         }
     }
 
-    DIR* dir = opendir(MODULE_DIR);
-    if (!dir) {
-        return "";
-    }
-
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (entry->d_name[0] == '.') {
-            continue;
-        }
-        if (entry->d_type != DT_DIR) {
-            continue;
-        }
-
-        const std::string module_path = std::string(MODULE_DIR) + entry->d_name;
-        const auto props = parse_module_prop(module_path + "/module.prop");
-        if (is_metamodule(props)) {
-            closedir(dir);
-            return module_path;
+    for (const auto& m : module_registry()) {
+        if (m.metamodule) {
+            return m.path;
         }
     }
-
-    closedir(dir);
     return "";
 }
 
@@ -664,19 +626,22 @@ int module_install(const std::string& zip_path) {
         return 1;
     }
 
-    const std::string tmp_module_prop = "/dev/ksud_module_install";
-    exec_command({"rm", "-rf", tmp_module_prop});
-    const auto extract_result =
-        exec_command({"unzip", "-o", "-q", zip_path, "module.prop", "-d", tmp_module_prop});
-    if (extract_result.exit_code != 0) {
-        printf("! Unable to extract zip file\n");
-        exec_command({"rm", "-rf", tmp_module_prop});
-        return 1;
+    const int64_t install_start_us = timeline_now_us();
+    std::map<std::string, std::string> props;
+    uint64_t uncompressed_size = 0;
+    {
+        // One central-directory pass answers module.prop and the size check
+        ZipReader reader(zip_path);
+        std::string zip_error;
+        const auto prop_text = reader.read_entry("module.prop", MODULE_PROP_MAX_SIZE, &zip_error);
+        if (!prop_text) {
+            printf("! Unable to read module.prop from zip: %s\n", zip_error.c_str());
+            return 1;
+        }
+        props = parse_module_prop_text(*prop_text);
+        uncompressed_size = reader.uncompressed_size();
     }
 
-    const auto props = parse_module_prop(tmp_module_prop + "/module.prop");
-    exec_command({"rm", "-rf", tmp_module_prop});
-
     const std::string mod_id = props.count("id") ? trim(props.at("id")) : "";
     if (mod_id.empty()) {
         printf("! Module ID not found in module.prop\n");
@@ -727,25 +692,43 @@ int module_install(const std::string& zip_path) {
         }
     }
 
+    // Only a hint: the installer may skip or replace entries, so the sum of
+    // uncompressed sizes is not what the module will really take.
+    struct statvfs adb_fs{};
+    if (statvfs(ADB_DIR, &adb_fs) == 0) {
+        const uint64_t available = static_cast<uint64_t>(adb_fs.f_bavail) * adb_fs.f_frsize;
+        if (available < uncompressed_size) {
+            printf("! Warning: %s may be short on space: archive holds %llu KiB, %llu KiB free\n",
+                   ADB_DIR, static_cast<unsigned long long>(uncompressed_size / 1024),
+                   static_cast<unsigned long long>(available / 1024));
+        }
+    }
+
     // Use the embedded installer script (same as the official Rust ksud flow)
     if (!exec_install_script(zip_path, installing_metamodule, mod_id)) {
         printf("! Module installation failed\n");
         return 1;
     }
 
+    // Mirror module.prop into MODULE_DIR so the manager lists the pending update
     const std::string final_module = std::string(MODULE_DIR) + mod_id;
-    exec_command({"mkdir", "-p", std::string(MODULE_DIR)});
-    exec_command({"mkdir", "-p", final_module});
-    exec_command({"cp", "-f", std::string(MODULE_UPDATE_DIR) + mod_id + "/module.prop",
-                  final_module + "/module.prop"});
-    exec_command({"touch", final_module + "/" + UPDATE_FILE_NAME});
+    std::error_code ec;
+    if (!ensure_dir_exists(final_module) ||
+        !std::filesystem::copy_file(std::string(MODULE_UPDATE_DIR) + mod_id + "/module.prop",
+                                    final_module + "/module.prop",
+                                    std::filesystem::copy_options::overwrite_existing, ec) ||
+        !ensure_file_exists(final_module + "/" + UPDATE_FILE_NAME)) {
+        LOGW("Failed to stage %s for update: %s", final_module.c_str(),
+             ec ? ec.message().c_str() : strerror(errno));
+    }
 
     if (installing_metamodule && !create_metamodule_symlink(mod_id)) {
         printf("! Failed to create metamodule symlink\n");
         return 1;
     }
 
-    LOGI("Module installed successfully");
+    LOGI("Module %s installed in %lld ms", mod_id.c_str(),
+         static_cast<long long>((timeline_now_us() - install_start_us) / 1000));
     warn_regenerate_preinit_rc_failed(regenerate_preinit_rc());
     warn_refresh_yukizygisk_early_snapshot_failed();
     return 0;
@@ -884,31 +867,27 @@ int module_run_action(const std::string& id) {
 
 namespace {
 
-bool load_module_info(const std::string& module_path, const std::string& fallback_id,
-                      bool pending_update, ModuleInfo& info) {
-    const std::string prop_path = module_path + "/module.prop";
-    if (!file_exists(prop_path)) {
+bool load_module_info(const ModuleEntry& m, bool pending_update, ModuleInfo& info) {
+    if (!m.has("module.prop")) {
         return false;
     }
 
-    auto props = parse_module_prop(prop_path);
+    auto props = m.props;
+    const std::string& module_path = m.path;
 
-    info.id = props.count("id") ? props["id"] : fallback_id;
+    info.id = props.count("id") ? props["id"] : m.id;
     info.name = props.count("name") ? props["name"] : info.id;
     info.version = props.count("version") ? props["version"] : "";
     info.version_code = props.count("versionCode") ? props["versionCode"] : "";
     info.author = props.count("author") ? props["author"] : "";
     info.description = props.count("description") ? props["description"] : "";
-    info.enabled = !file_exists(module_path + "/" + DISABLE_FILE_NAME);
-    info.update = pending_update || file_exists(module_path + "/" + UPDATE_FILE_NAME);
-    info.remove = file_exists(module_path + "/" + REMOVE_FILE_NAME);
-    info.web = file_exists(module_path + "/" + MODULE_WEB_DIR);
-    info.action = file_exists(module_path + "/" + MODULE_ACTION_SH);
-    info.mount = file_exists(module_path + "/system") && !file_exists(module_path + "/skip_mount");
-
-    const std::string metamodule_val = props.count("metamodule") ? props["metamodule"] : "";
-    info.metamodule =
-        (metamodule_val == "1" || metamodule_val == "true" || metamodule_val == "TRUE");
+    info.enabled = !m.disabled;
+    info.update = pending_update || m.update;
+    info.remove = m.removing;
+    info.web = m.has(MODULE_WEB_DIR);
+    info.action = m.has(MODULE_ACTION_SH);
+    info.mount = m.has("system") && !m.has("skip_mount");
+    info.metamodule = m.metamodule;
 
     if (props.count("actionIcon")) {
         info.actionIcon =
@@ -922,10 +901,27 @@ bool load_module_info(const std::string& module_path, const std::string& fallbac
     return true;
 }
 
-void collect_module_infos(const std::string& root_dir, bool pending_update,
-                          std::vector<ModuleInfo>& modules,
-                          std::map<std::string, size_t>& module_index) {
-    DIR* dir = opendir(root_dir.c_str());
+void collect_module_info(const ModuleEntry& m, bool pending_update,
+                         std::vector<ModuleInfo>& modules,
+                         std::map<std::string, size_t>& module_index) {
+    ModuleInfo info;
+    if (!load_module_info(m, pending_update, info)) {
+        return;
+    }
+
+    const auto [it, inserted] = module_index.emplace(info.id, modules.size());
+    if (inserted) {
+        modules.push_back(std::move(info));
+        return;
+    }
+
+    modules[it->second].update = modules[it->second].update || info.update;
+}
+
+// Pending updates are staged outside MODULE_DIR and are not in the registry
+void collect_pending_module_infos(std::vector<ModuleInfo>& modules,
+                                  std::map<std::string, size_t>& module_index) {
+    DIR* dir = opendir(MODULE_UPDATE_DIR);
     if (!dir) {
         return;
     }
@@ -939,19 +935,11 @@ void collect_module_infos(const std::string& root_dir, bool pending_update,
             continue;
         }
 
-        const std::string module_path = root_dir + entry->d_name;
-        ModuleInfo info;
-        if (!load_module_info(module_path, entry->d_name, pending_update, info)) {
-            continue;
+        ModuleEntry m;
+        if (read_module_entry(std::string(MODULE_UPDATE_DIR) + entry->d_name, entry->d_name,
+                              m)) {
+            collect_module_info(m, true, modules, module_index);
         }
-
-        const auto [it, inserted] = module_index.emplace(info.id, modules.size());
-        if (inserted) {
-            modules.push_back(std::move(info));
-            continue;
-        }
-
-        modules[it->second].update = modules[it->second].update || info.update;
     }
 
     closedir(dir);
@@ -962,8 +950,10 @@ void collect_module_infos(const std::string& root_dir, bool pending_update,
 int module_list() {
     std::vector<ModuleInfo> modules;
     std::map<std::string, size_t> module_index;
-    collect_module_infos(MODULE_DIR, false, modules, module_index);
-    collect_module_infos(MODULE_UPDATE_DIR, true, modules, module_index);
+    for (const auto& m : module_registry()) {
+        collect_module_info(m, false, modules, module_index);
+    }
+    collect_pending_module_infos(modules, module_index);
 
     // Output JSON array
     printf("[\n");
@@ -997,46 +987,20 @@ int module_list() {
 }
 
 int uninstall_all_modules() {
-    DIR* dir = opendir(MODULE_DIR);
-    if (!dir)
-        return 0;
-
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (entry->d_name[0] == '.')
-            continue;
-        if (entry->d_type != DT_DIR)
-            continue;
-
-        module_uninstall(entry->d_name);
-    }
-
-    closedir(dir);
+    for (const auto& m : module_registry())
+        module_uninstall(m.id);
     return 0;
 }
 
 int prune_modules() {
     // Remove modules marked for removal
-    DIR* dir = opendir(MODULE_DIR);
-    if (!dir)
-        return 0;
-
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (entry->d_name[0] == '.')
-            continue;
-        if (entry->d_type != DT_DIR)
-            continue;
+    for (const auto& m : module_registry()) {
+        const std::string& module_path = m.path;
 
-        const std::string module_path = std::string(MODULE_DIR) + entry->d_name;
-        const std::string remove_flag = module_path + "/" + REMOVE_FILE_NAME;
+        if (m.removing) {
+            const std::string& module_id = m.id;
 
-        if (file_exists(remove_flag)) {
-            const std::string module_id = entry->d_name;
-            const auto props = parse_module_prop(module_path + "/module.prop");
-            const bool removing_metamodule = is_metamodule(props);
-
-            if (removing_metamodule) {
+            if (m.metamodule) {
                 remove_metamodule_symlink();
             } else {
                 const int metauninstall_rc = metamodule_exec_uninstall_script(module_id);
@@ -1047,7 +1011,7 @@ int prune_modules() {
             }
 
             const std::string uninstall_script = module_path + "/uninstall.sh";
-            if (file_exists(uninstall_script)) {
+            if (m.has("uninstall.sh")) {
                 const int uninstall_rc = run_script(uninstall_script, true, module_id);
                 if (uninstall_rc != 0) {
                     LOGW("uninstall.sh failed for %s with code %d", module_id.c_str(),
@@ -1060,33 +1024,19 @@ int prune_modules() {
             std::error_code ec;
             std::filesystem::remove_all(module_path, ec);
             if (ec) {
-                LOGW("Failed to remove module %s: %s", entry->d_name, ec.message().c_str());
+                LOGW("Failed to remove module %s: %s", module_id.c_str(), ec.message().c_str());
             } else {
-                LOGI("Removed module %s", entry->d_name);
+                LOGI("Removed module %s", module_id.c_str());
             }
         }
     }
 
-    closedir(dir);
     return 0;
 }
 
 int disable_all_modules() {
-    DIR* dir = opendir(MODULE_DIR);
-    if (!dir)
-        return 0;
-
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (entry->d_name[0] == '.')
-            continue;
-        if (entry->d_type != DT_DIR)
-            continue;
-
-        module_disable(entry->d_name);
-    }
-
-    closedir(dir);
+    for (const auto& m : module_registry())
+        module_disable(m.id);
     return 0;
 }
 
@@ -1097,6 +1047,10 @@ int handle_updated_modules() {
     if (!dir)
         return 0;
 
+    std::map<std::string, ModuleEntry> installed;
+    for (auto& m : module_registry())
+        installed.emplace(m.id, std::move(m));
+
     struct dirent* entry;
     while ((entry = readdir(dir)) != nullptr) {
         if (entry->d_name[0] == '.')
@@ -1106,8 +1060,9 @@ int handle_updated_modules() {
 
         const std::string src = update_dir + entry->d_name;
         const std::string dst = std::string(MODULE_DIR) + entry->d_name;
-        const bool disabled = file_exists(dst + "/" + DISABLE_FILE_NAME);
-        const bool removed = file_exists(dst + "/" + REMOVE_FILE_NAME);
+        const auto old = installed.find(entry->d_name);
+        const bool disabled = old != installed.end() && old->second.disabled;
+        const bool removed = old != installed.end() && old->second.removing;
 
         // Remove old module if exists
         if (file_exists(dst)) {
@@ -1136,57 +1091,335 @@ int handle_updated_modules() {
     return 0;
 }
 
-int run_script(const std::string& script, bool block, const std::string& module_id) {
-    if (!file_exists(script))
-        return 0;
+namespace {
 
-    LOGI("Running script: %s", script.c_str());
+// Variables apply_common_script_env() sets or clears; inherited copies are
+// dropped from the prepared block.
+constexpr std::array<const char*, 14> COMMON_SCRIPT_ENV_NAMES = {
+    "ASH_STANDALONE", "KSU", "YUKISU", "KSU_KERNEL_VER_CODE", "KSU_VER_CODE", "KSU_VER",
+    "KSU_UAPI_VER", "KSU_RUNTIME_MODE", "PATH", "ZYGISK_ENABLED", "KSU_LATE_LOAD", "MAGISK_VER",
+    "MAGISK_VER_CODE", "KSU_MODULE"};
 
-    // Use busybox for script execution (like Rust version)
-    std::string busybox = BUSYBOX_PATH;
-    if (!file_exists(busybox)) {
-        LOGW("Busybox not found at %s, falling back to /system/bin/sh", BUSYBOX_PATH);
-        busybox = "/system/bin/sh";
-    }
+bool env_entry_named(const char* entry, const char* name, size_t name_len) {
+    return strncmp(entry, name, name_len) == 0 && entry[name_len] == '=';
+}
+
+// Everything a script spawn needs that does not depend on the script. Taken
+// when a stage starts, so it sees the busybox and features set up before it.
+struct ScriptLaunchContext {
+    std::string shell;
+    std::vector<std::string> env;  // NAME=value, without KSU_MODULE
+    std::vector<int> cgroup_fds;
+
+    ScriptLaunchContext() {
+        // Use busybox for script execution (like Rust version)
+        shell = BUSYBOX_PATH;
+        if (!file_exists(shell)) {
+            LOGW("Busybox not found at %s, falling back to /system/bin/sh", BUSYBOX_PATH);
+            shell = "/system/bin/sh";
+        }
+
+        for (char** e = environ; e != nullptr && *e != nullptr; ++e) {
+            const bool ours = std::any_of(
+                COMMON_SCRIPT_ENV_NAMES.begin(), COMMON_SCRIPT_ENV_NAMES.end(),
+                [&](const char* name) { return env_entry_named(*e, name, strlen(name)); });
+            if (!ours)
+                env.emplace_back(*e);
+        }
+
+        // Same values as apply_common_script_env(env, id, true)
+        const CommonScriptEnv common = build_common_script_env();
+        env.emplace_back("ASH_STANDALONE=1");
+        env.emplace_back("KSU=true");
+        env.emplace_back("YUKISU=1");
+        env.push_back("KSU_KERNEL_VER_CODE=" + common.kernel_ver_code);
+        env.push_back(std::string("KSU_VER_CODE=") + VERSION_CODE);
+        env.push_back(std::string("KSU_VER=") + VERSION_NAME);
+        env.push_back("KSU_UAPI_VER=" + common.uapi_version);
+        env.push_back("KSU_RUNTIME_MODE=" + common.runtime_mode);
+        env.push_back("PATH=" + common.path);
+        if (common.zygisk_enabled)
+            env.emplace_back("ZYGISK_ENABLED=1");
+        if (common.late_load)
+            env.emplace_back("KSU_LATE_LOAD=1");
+        env.emplace_back("MAGISK_VER=25.2");
+        env.emplace_back("MAGISK_VER_CODE=25200");
+
+        cgroup_fds = open_cgroup_escape_fds();
+    }
+    ~ScriptLaunchContext() {
+        for (const int fd : cgroup_fds)
+            close(fd);
+    }
+    ScriptLaunchContext(const ScriptLaunchContext&) = delete;
+    ScriptLaunchContext& operator=(const ScriptLaunchContext&) = delete;
+};
+
+pid_t spawn_with_context(const ScriptLaunchContext& ctx, const std::string& script,
+                         const std::string& module_id, const std::string& extra_env,
+                         int64_t* spawn_us) {
 
     // Get the script's directory for current_dir
     std::string script_dir = script.substr(0, script.find_last_of('/'));
     if (script_dir.empty())
         script_dir = "/";
 
-    // Prepare all environment variable values BEFORE fork
-    // to avoid calling C++ library functions in child process
-    const CommonScriptEnv common_env = build_common_script_env();
-
-    // Make copies of string data that child process will use
-    const char* busybox_path = busybox.c_str();
-    const char* script_path = script.c_str();
-    const char* script_dir_path = script_dir.c_str();
-    const char* module_id_cstr = module_id.c_str();
-
-    const pid_t pid = fork();
+    // Everything the child touches is laid out here: it shares our memory
+    // until execve and may only make plain system calls.
+    const std::string module_env = "KSU_MODULE=" + module_id;
+    const size_t extra_name_len = extra_env.find('=');
+    std::vector<char*> envp;
+    envp.reserve(ctx.env.size() + 3);
+    for (const auto& e : ctx.env) {
+        if (extra_name_len != std::string::npos &&
+            env_entry_named(e.c_str(), extra_env.c_str(), extra_name_len))
+            continue;
+        envp.push_back(const_cast<char*>(e.c_str()));
+    }
+    if (!module_id.empty())
+        envp.push_back(const_cast<char*>(module_env.c_str()));
+    if (extra_name_len != std::string::npos)
+        envp.push_back(const_cast<char*>(extra_env.c_str()));
+    envp.push_back(nullptr);
+
+    std::array<char*, 3> argv = {const_cast<char*>("sh"), const_cast<char*>(script.c_str()),
+                                 nullptr};
+    const char* shell = ctx.shell.c_str();
+    const char* cwd = script_dir.c_str();
+    const int* cgroup_fds = ctx.cgroup_fds.data();
+    const size_t cgroup_count = ctx.cgroup_fds.size();
+
+    const int64_t start_us = timeline_now_us();
+    // The parent resumes once the child has exec'd, so no copy of our page
+    // tables is ever made.
+    const pid_t pid = vfork();
     if (pid == 0) {
-        // Child process
+        // Lead a session so a whole script tree can be killed at once
         setsid();
-
-        // Switch cgroups to escape from parent cgroup (like Rust version)
-        switch_cgroups();
-
+        // Escape from the parent cgroups (like Rust version)
+        for (size_t i = 0; i < cgroup_count; ++i)
+            (void)write(cgroup_fds[i], "0", 1);
         // Change to script directory (like Rust version)
-        chdir(script_dir_path);
-
-        // Set environment variables (matching Rust version's get_common_script_envs)
-        apply_common_script_env(common_env, module_id_cstr, true);
-
-        // Execute with busybox sh
-        execl(busybox_path, "sh", script_path, nullptr);
+        (void)chdir(cwd);
+        execve(shell, argv.data(), envp.data());
         _exit(127);
     }
 
     if (pid < 0) {
-        LOGE("Failed to fork for script: %s", script.c_str());
+        LOGE("Failed to spawn script: %s: %s", script.c_str(), strerror(errno));
         return -1;
     }
+    if (spawn_us != nullptr)
+        *spawn_us = timeline_now_us() - start_us;
+    return pid;
+}
+
+}  // namespace
+
+pid_t spawn_module_script(const std::string& script, const std::string& module_id,
+                          const std::string& extra_env, int64_t* spawn_us) {
+    const ScriptLaunchContext ctx;
+    return spawn_with_context(ctx, script, module_id, extra_env, spawn_us);
+}
+
+namespace {
+
+int64_t now_ms() {
+    return timeline_now_us() / 1000;
+}
+
+struct StageScriptConfig {
+    int jobs = STAGE_SCRIPT_JOBS_DEFAULT;
+    int timeout_sec = STAGE_SCRIPT_TIMEOUT_DEFAULT;
+};
+
+StageScriptConfig load_stage_script_config() {
+    StageScriptConfig cfg;
+    const auto props = parse_module_prop(STAGE_SCRIPTS_CONFIG);
+    uint32_t value = 0;
+    if (auto it = props.find("jobs"); it != props.end() && parse_uint32(it->second, &value))
+        cfg.jobs = static_cast<int>(std::clamp<uint32_t>(value, 1, 64));
+    if (auto it = props.find("timeout"); it != props.end() && parse_uint32(it->second, &value))
+        cfg.timeout_sec = static_cast<int>(std::min<uint32_t>(value, 3600));
+    return cfg;
+}
+
+// One stage script plus its ordering edges, filled in as it runs.
+struct StageJob {
+    std::string name;  // module id, or file name for common scripts
+    std::string script;
+    std::string module_id;
+    std::vector<size_t> before;  // jobs that may only start once this one ends
+    size_t pending = 0;          // unfinished jobs this one is ordered after
+    pid_t pid = -1;
+    int64_t start_ms = -1;
+    int64_t end_ms = -1;
+    int status = -1;
+    int64_t spawn_us = 0;
+    bool started = false;
+    bool timed_out = false;
+};
+
+// Split an after=/before= list on commas and whitespace.
+std::vector<std::string> split_module_ids(const std::string& value) {
+    std::vector<std::string> ids;
+    std::string cur;
+    for (const char c : value) {
+        if (c == ',' || std::isspace(static_cast<unsigned char>(c)) != 0) {
+            if (!cur.empty())
+                ids.push_back(std::move(cur));
+            cur.clear();
+        } else {
+            cur += c;
+        }
+    }
+    if (!cur.empty())
+        ids.push_back(std::move(cur));
+    return ids;
+}
+
+void order_jobs(std::vector<StageJob>& jobs, size_t first, size_t then) {
+    if (first == then)
+        return;
+    auto& edges = jobs[first].before;
+    if (std::find(edges.begin(), edges.end(), then) != edges.end())
+        return;
+    edges.push_back(then);
+    jobs[then].pending++;
+}
+
+void finish_job(std::vector<StageJob>& jobs, size_t i, int status, int64_t now) {
+    StageJob& job = jobs[i];
+    job.end_ms = now;
+    job.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    for (const size_t next : job.before) {
+        if (jobs[next].pending > 0)
+            jobs[next].pending--;
+    }
+}
+
+// Run jobs respecting their ordering, at most max_jobs at once. Scripts that
+// outlive timeout_sec (0 = no limit) lose their whole process group. Logs the
+// resulting schedule and adds every script to the boot timeline.
+void run_stage_jobs(const std::string& stage, std::vector<StageJob>& jobs, int max_jobs,
+                    int timeout_sec) {
+    if (jobs.empty())
+        return;
+
+    constexpr useconds_t POLL_INTERVAL_US = 5000;
+    const ScriptLaunchContext ctx;
+    const int64_t stage_start = now_ms();
+    std::vector<size_t> running;
+    size_t done = 0;
+
+    while (done < jobs.size()) {
+        // Launch ready jobs in name order until the parallelism is used up.
+        for (size_t i = 0; i < jobs.size() && running.size() < static_cast<size_t>(max_jobs);
+             ++i) {
+            StageJob& job = jobs[i];
+            if (job.started || job.pending != 0)
+                continue;
+            job.started = true;
+            job.start_ms = now_ms();
+            LOGI("Running script: %s", job.script.c_str());
+            job.pid = spawn_with_context(ctx, job.script, job.module_id, "", &job.spawn_us);
+            if (job.pid < 0) {
+                finish_job(jobs, i, -1, job.start_ms);
+                done++;
+                continue;
+            }
+            running.push_back(i);
+        }
+
+        if (running.empty()) {
+            if (done == jobs.size())
+                break;
+            // Everything left waits on something: an after/before cycle.
+            for (size_t i = 0; i < jobs.size(); ++i) {
+                if (!jobs[i].started) {
+                    LOGW("%s: ordering cycle at %s, starting it anyway", stage.c_str(),
+                         jobs[i].name.c_str());
+                    jobs[i].pending = 0;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        bool reaped = false;
+        const int64_t now = now_ms();
+        for (auto it = running.begin(); it != running.end();) {
+            StageJob& job = jobs[*it];
+            int status = 0;
+            if (waitpid(job.pid, &status, WNOHANG) == job.pid) {
+                finish_job(jobs, *it, status, now);
+                it = running.erase(it);
+                done++;
+                reaped = true;
+                continue;
+            }
+            if (timeout_sec > 0 && !job.timed_out &&
+                now - job.start_ms >= static_cast<int64_t>(timeout_sec) * 1000) {
+                LOGW("%s: %s exceeded %ds, killing", stage.c_str(), job.name.c_str(),
+                     timeout_sec);
+                kill(-job.pid, SIGKILL);
+                kill(job.pid, SIGKILL);
+                job.timed_out = true;
+            }
+            ++it;
+        }
+        if (!reaped)
+            usleep(POLL_INTERVAL_US);
+    }
+
+    const int64_t total = now_ms() - stage_start;
+    int64_t serial = 0;
+    int64_t spawn_total_us = 0;
+    int64_t spawn_max_us = 0;
+    for (const auto& job : jobs) {
+        if (job.start_ms < 0)
+            continue;
+        serial += job.end_ms - job.start_ms;
+        spawn_total_us += job.spawn_us;
+        spawn_max_us = std::max(spawn_max_us, job.spawn_us);
+        timeline_record(stage, job.name, job.start_ms * 1000, job.end_ms * 1000);
+        LOGI("%s: %-24s start=+%lldms took=%lldms exit=%d%s", stage.c_str(), job.name.c_str(),
+             static_cast<long long>(job.start_ms - stage_start),
+             static_cast<long long>(job.end_ms - job.start_ms), job.status,
+             job.timed_out ? " (timed out)" : "");
+    }
+    LOGI("%s: %zu script(s), jobs=%d, wall=%lldms, serial sum=%lldms", stage.c_str(),
+         jobs.size(), max_jobs, static_cast<long long>(total), static_cast<long long>(serial));
+    LOGI("%s: spawn latency avg=%lldus max=%lldus", stage.c_str(),
+         static_cast<long long>(spawn_total_us / static_cast<int64_t>(jobs.size())),
+         static_cast<long long>(spawn_max_us));
+}
+
+// Non-blocking stages with ordering constraints hand the schedule to a
+// detached child so the caller still returns immediately.
+void run_stage_jobs_detached(const std::string& stage, std::vector<StageJob>& jobs) {
+    const pid_t pid = fork();
+    if (pid == 0) {
+        run_stage_jobs(stage, jobs, static_cast<int>(jobs.size()), 0);
+        _exit(0);
+    }
+    if (pid < 0)
+        LOGE("Failed to fork %s scheduler", stage.c_str());
+}
+
+}  // namespace
+
+int run_script(const std::string& script, bool block, const std::string& module_id) {
+    if (!file_exists(script))
+        return 0;
+
+    LOGI("Running script: %s", script.c_str());
+
+    int64_t spawn_us = 0;
+    const pid_t pid = spawn_module_script(script, module_id, "", &spawn_us);
+    if (pid < 0)
+        return -1;
+    LOGD("Spawned %s in %lldus", script.c_str(), static_cast<long long>(spawn_us));
 
     if (block) {
         int status;
@@ -1198,43 +1431,69 @@ int run_script(const std::string& script, bool block, const std::string& module_
 }
 
 int exec_stage_script(const std::string& stage, bool block) {
-    DIR* dir = opendir(MODULE_DIR);
-    if (!dir)
-        return 0;
-
     const std::string metamodule_id = get_metamodule_id_impl();
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (entry->d_name[0] == '.')
-            continue;
-        if (entry->d_type != DT_DIR)
+    const std::string script_name = stage + ".sh";
+    const std::vector<ModuleEntry> modules = module_registry();
+
+    // The registry is in id order, which keeps the schedule reproducible
+    // across boots.
+    std::vector<StageJob> jobs;
+    std::vector<const std::map<std::string, std::string>*> props;
+    for (const auto& m : modules) {
+        if (!metamodule_id.empty() && m.id == metamodule_id)
             continue;
 
-        const std::string module_id = entry->d_name;
-        if (!metamodule_id.empty() && module_id == metamodule_id)
-            continue;
-
-        const std::string module_path = std::string(MODULE_DIR) + module_id;
-
-        // Skip disabled modules
-        if (file_exists(module_path + "/" + DISABLE_FILE_NAME))
+        // Skip disabled modules and modules marked for removal
+        if (!m.active())
             continue;
 
-        // Skip modules marked for removal
-        if (file_exists(module_path + "/" + REMOVE_FILE_NAME))
+        // Run stage script with module_id for KSU_MODULE env var
+        if (!m.has(script_name))
             continue;
 
-        // Run stage script with module_id for KSU_MODULE env var
-        std::string script;
-        script.reserve(module_path.size() + 1U + stage.size() + 3U);
-        script += module_path;
-        script += "/";
-        script += stage;
-        script += ".sh";
-        run_script(script, block, module_id);
+        StageJob job;
+        job.name = m.id;
+        job.script = m.path + "/" + script_name;
+        job.module_id = m.id;
+        jobs.push_back(std::move(job));
+        props.push_back(&m.props);
+    }
+
+    // module.prop "after=" / "before=" name other module ids; ids without a
+    // script in this stage are ignored.
+    std::map<std::string, size_t> index;
+    for (size_t i = 0; i < jobs.size(); ++i)
+        index[jobs[i].name] = i;
+    bool ordered = false;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const auto& p = *props[i];
+        if (auto it = p.find("after"); it != p.end()) {
+            for (const auto& id : split_module_ids(it->second)) {
+                if (auto dep = index.find(id); dep != index.end()) {
+                    order_jobs(jobs, dep->second, i);
+                    ordered = true;
+                }
+            }
+        }
+        if (auto it = p.find("before"); it != p.end()) {
+            for (const auto& id : split_module_ids(it->second)) {
+                if (auto dep = index.find(id); dep != index.end()) {
+                    order_jobs(jobs, i, dep->second);
+                    ordered = true;
+                }
+            }
+        }
     }
 
-    closedir(dir);
+    if (block) {
+        const StageScriptConfig cfg = load_stage_script_config();
+        run_stage_jobs(script_name, jobs, cfg.jobs, cfg.timeout_sec);
+    } else if (ordered) {
+        run_stage_jobs_detached(script_name, jobs);
+    } else {
+        for (const auto& job : jobs)
+            run_script(job.script, false, job.module_id);
+    }
     return 0;
 }
 
@@ -1244,6 +1503,7 @@ int exec_common_scripts(const std::string& stage_dir, bool block) {
     if (!dir)
         return 0;
 
+    std::vector<StageJob> jobs;
     struct dirent* entry;
     while ((entry = readdir(dir)) != nullptr) {
         if (entry->d_name[0] == '.')
@@ -1252,37 +1512,37 @@ int exec_common_scripts(const std::string& stage_dir, bool block) {
         if (access(script.c_str(), X_OK) != 0)
             continue;
 
-        run_script(script, block);
+        StageJob job;
+        job.name = entry->d_name;
+        job.script = script;
+        jobs.push_back(std::move(job));
     }
-
     closedir(dir);
+
+    // Common scripts cannot declare ordering, so they keep running one at a
+    // time in name order; blocking stages still get the time budget.
+    std::sort(jobs.begin(), jobs.end(),
+              [](const StageJob& a, const StageJob& b) { return a.name < b.name; });
+    if (block) {
+        run_stage_jobs(stage_dir, jobs, 1, load_stage_script_config().timeout_sec);
+    } else {
+        for (const auto& job : jobs)
+            run_script(job.script, false);
+    }
     return 0;
 }
 
 int load_sepolicy_rule() {
-    DIR* dir = opendir(MODULE_DIR);
-    if (!dir)
-        return 0;
-
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (entry->d_name[0] == '.')
-            continue;
-        if (entry->d_type != DT_DIR)
-            continue;
-
-        const std::string module_path = std::string(MODULE_DIR) + entry->d_name;
-
+    for (const auto& m : module_registry()) {
         // Skip disabled modules
-        if (file_exists(module_path + "/" + DISABLE_FILE_NAME))
+        if (m.disabled)
             continue;
 
-        const std::string rule_file = module_path + "/sepolicy.rule";
-        if (!file_exists(rule_file))
+        if (!m.has("sepolicy.rule"))
             continue;
 
         // Read and apply rules
-        std::ifstream ifs(rule_file);
+        std::ifstream ifs(m.path + "/sepolicy.rule");
         std::string line;
         std::string all_rules;
         while (std::getline(ifs, line)) {
@@ -1293,92 +1553,199 @@ int load_sepolicy_rule() {
         }
 
         if (!all_rules.empty()) {
-            LOGI("Applying sepolicy rules from %s", entry->d_name);
+            LOGI("Applying sepolicy rules from %s", m.id.c_str());
             const int ret = sepolicy_live_patch(all_rules);
             if (ret != 0) {
-                LOGW("Failed to apply some sepolicy rules from %s", entry->d_name);
+                LOGW("Failed to apply some sepolicy rules from %s", m.id.c_str());
             }
         }
     }
 
-    closedir(dir);
     return 0;
 }
 
-int load_system_prop() {
-    DIR* dir = opendir(MODULE_DIR);
-    if (!dir)
-        return 0;
+namespace {
 
-    // Check if resetprop exists
-    if (!file_exists(RESETPROP_PATH)) {
-        LOGW("resetprop not found at %s, skipping system.prop loading", RESETPROP_PATH);
-        closedir(dir);
-        return 0;
-    }
+struct SystemProp {
+    std::string key;
+    std::string value;
+    std::string module;  // last writer
+    size_t line = 0;
+};
 
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (entry->d_name[0] == '.')
-            continue;
-        if (entry->d_type != DT_DIR)
-            continue;
+constexpr size_t PROP_VALUE_MAX_LEN = 91;  // PROP_VALUE_MAX - 1; ro.* may be longer
 
-        const std::string module_path = std::string(MODULE_DIR) + entry->d_name;
+bool valid_prop_key(const std::string& key) {
+    if (key.empty() || key.front() == '.' || key.back() == '.')
+        return false;
+    return std::all_of(key.begin(), key.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) != 0 || c == '.' || c == '_' ||
+               c == '-' || c == '@' || c == ':';
+    });
+}
+
+// Every enabled module's system.prop, merged: modules in id order, lines in
+// file order, a later definition of a key replacing an earlier one. Invalid
+// lines are reported and skipped.
+std::vector<SystemProp> collect_system_props(size_t* modules, size_t* overridden) {
+    std::vector<SystemProp> props;
+    std::map<std::string, size_t> index;
+    for (const auto& m : module_registry()) {
+        const std::string& id = m.id;
 
         // Skip disabled modules
-        if (file_exists(module_path + "/" + DISABLE_FILE_NAME))
+        if (m.disabled || !m.has("system.prop"))
             continue;
 
-        const std::string prop_file = module_path + "/system.prop";
-        if (!file_exists(prop_file))
+        std::ifstream ifs(m.path + "/system.prop");
+        if (!ifs)
             continue;
+        (*modules)++;
 
-        LOGI("Loading system.prop from %s", entry->d_name);
-
-        // Read and set properties
-        std::ifstream ifs(prop_file);
         std::string line;
+        size_t line_no = 0;
         while (std::getline(ifs, line)) {
+            line_no++;
             line = trim(line);
             if (line.empty() || line[0] == '#')
                 continue;
 
             const size_t eq = line.find('=');
-            if (eq == std::string::npos)
+            const std::string key = trim(line.substr(0, eq));
+            const std::string value = eq == std::string::npos ? "" : trim(line.substr(eq + 1));
+            if (eq == std::string::npos || !valid_prop_key(key)) {
+                LOGW("system.prop: %s:%zu: invalid line skipped: %s", id.c_str(), line_no,
+                     line.c_str());
                 continue;
+            }
+            if (value.size() > PROP_VALUE_MAX_LEN && !starts_with(key, "ro.")) {
+                LOGW("system.prop: %s:%zu: value of %s too long (%zu), skipped", id.c_str(),
+                     line_no, key.c_str(), value.size());
+                continue;
+            }
 
-            const std::string key = trim(line.substr(0, eq));
-            const std::string value = trim(line.substr(eq + 1));
+            auto [it, inserted] = index.emplace(key, props.size());
+            if (inserted) {
+                props.push_back({key, value, id, line_no});
+                continue;
+            }
+            SystemProp& prev = props[it->second];
+            if (prev.value != value) {
+                LOGI("system.prop: %s=%s from %s:%zu overrides %s:%zu", key.c_str(),
+                     value.c_str(), id.c_str(), line_no, prev.module.c_str(), prev.line);
+                (*overridden)++;
+            }
+            prev.value = value;
+            prev.module = id;
+            prev.line = line_no;
+        }
+    }
+    return props;
+}
+
+}  // namespace
+
+int load_system_prop() {
+    // Check if resetprop exists
+    if (!file_exists(RESETPROP_PATH)) {
+        LOGW("resetprop not found at %s, skipping system.prop loading", RESETPROP_PATH);
+        return 0;
+    }
+
+    size_t modules = 0;
+    size_t overridden = 0;
+    const std::vector<SystemProp> props = collect_system_props(&modules, &overridden);
+    if (props.empty())
+        return 0;
+    const int64_t start = timeline_now_us();
 
-            // Execute resetprop in a child process
-            const pid_t pid = fork();
-            if (pid == 0) {
 #if defined(RESETPROP_ALONE_AVAILABLE) && RESETPROP_ALONE_AVAILABLE
-                const char* k = key.c_str();
-                const char* v = value.c_str();
+    // One child applies everything, so the property areas are set up once and
+    // resetprop exiting on a bad value cannot take post-fs-data down with it.
+    // The child reports each index before applying it; if it dies, the last one
+    // reported is the culprit and a new child resumes after it.
+    size_t next = 0;
+    bool any_failed = false;
+    while (next < props.size()) {
+        int progress[2];
+        if (pipe2(progress, O_CLOEXEC) != 0) {
+            LOGE("Failed to create system.prop pipe: %s", strerror(errno));
+            return -1;
+        }
+        const pid_t pid = fork();
+        if (pid == 0) {
+            close(progress[0]);
+            int failed = 0;
+            for (size_t i = next; i < props.size(); ++i) {
+                const auto& p = props[i];
+                const uint32_t at = static_cast<uint32_t>(i);
+                (void)write(progress[1], &at, sizeof(at));
                 std::array<char*, 5> argv_c = {
                     const_cast<char*>("resetprop"),
                     const_cast<char*>("-n"),
-                    const_cast<char*>(k),
-                    const_cast<char*>(v),
+                    const_cast<char*>(p.key.c_str()),
+                    const_cast<char*>(p.value.c_str()),
                     nullptr,
                 };
-                const int rc = resetprop_main(4, argv_c.data());
-                _exit(rc);
-#else
-                execl(RESETPROP_PATH, "resetprop", "-n", key.c_str(), value.c_str(), nullptr);
-                _exit(127);
-#endif  // #if defined(RESETPROP_ALONE_AVAILABLE) ...
-            }
-            if (pid > 0) {
-                int status;
-                waitpid(pid, &status, 0);
+                if (resetprop_main(4, argv_c.data()) != 0) {
+                    LOGW("system.prop: failed to set %s (%s:%zu)", p.key.c_str(),
+                         p.module.c_str(), p.line);
+                    failed++;
+                }
             }
+            const auto done = static_cast<uint32_t>(props.size());
+            (void)write(progress[1], &done, sizeof(done));
+            _exit(failed == 0 ? 0 : 1);
+        }
+        close(progress[1]);
+        if (pid < 0) {
+            close(progress[0]);
+            LOGE("Failed to fork for system.prop: %s", strerror(errno));
+            return -1;
+        }
+        size_t reached = next;
+        uint32_t at = 0;
+        for (;;) {
+            const ssize_t n = read(progress[0], &at, sizeof(at));
+            if (n == static_cast<ssize_t>(sizeof(at)))
+                reached = at;
+            else if (n >= 0 || errno != EINTR)
+                break;
+        }
+        close(progress[0]);
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (reached >= props.size()) {
+            any_failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            break;
+        }
+        const auto& bad = props[reached];
+        LOGW("system.prop: resetprop died on %s=%s (%s:%zu, %s %d), skipping it",
+             bad.key.c_str(), bad.value.c_str(), bad.module.c_str(), bad.line,
+             WIFSIGNALED(status) ? "signal" : "exit",
+             WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+        any_failed = true;
+        next = reached + 1;
+    }
+    if (any_failed)
+        LOGW("system.prop: some properties were not applied");
+#else
+    for (const auto& p : props) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            execl(RESETPROP_PATH, "resetprop", "-n", p.key.c_str(), p.value.c_str(), nullptr);
+            _exit(127);
+        }
+        if (pid > 0) {
+            int status;
+            waitpid(pid, &status, 0);
         }
     }
+#endif  // #if defined(RESETPROP_ALONE_AVAILABLE) ...
 
-    closedir(dir);
+    LOGI("system.prop: %zu properties from %zu module(s), %zu overridden, in %lldms",
+         props.size(), modules, overridden,
+         static_cast<long long>((timeline_now_us() - start) / 1000));
     return 0;
 }
 
@@ -1434,25 +1801,11 @@ std::map<std::string, std::string> merge_module_configs(const std::string& modul
 std::map<std::string, std::vector<std::string>> get_managed_features() {
     std::map<std::string, std::vector<std::string>> managed_features_map;
 
-    DIR* dir = opendir(MODULE_DIR);
-    if (!dir) {
-        return managed_features_map;
-    }
-
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        if (entry->d_name[0] == '.')
-            continue;
-        if (entry->d_type != DT_DIR)
-            continue;
-
-        const std::string module_id = entry->d_name;
-        const std::string module_path = std::string(MODULE_DIR) + module_id;
+    for (const auto& m : module_registry()) {
+        const std::string& module_id = m.id;
 
         // Check if module is active (not disabled/removed)
-        if (file_exists(module_path + "/disable"))
-            continue;
-        if (file_exists(module_path + "/remove"))
+        if (!m.active())
             continue;
 
         // Read module config
@@ -1475,7 +1828,6 @@ std::map<std::string, std::vector<std::string>> get_managed_features() {
         }
     }
 
-    closedir(dir);
     return managed_features_map;
 }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <sys/types.h>
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
@@ -50,4 +52,12 @@ CommonScriptEnv build_common_script_env();
 void apply_common_script_env(const CommonScriptEnv& env, const char* module_id = nullptr,
                              bool set_magisk_compat = false);
 
+// Start `sh script` in its own session, outside the caller's cgroups, from the
+// script's directory, with the common environment plus KSU_MODULE (when
+// module_id is set) and an optional "NAME=value" extra. The environment block
+// and cgroup fds are built per call; stage runs build them once per stage.
+// spawn_us receives the time until the child has exec'd. Returns the pid, or -1.
+pid_t spawn_module_script(const std::string& script, const std::string& module_id,
+                          const std::string& extra_env = "", int64_t* spawn_us = nullptr);
+
 }  // namespace ksud
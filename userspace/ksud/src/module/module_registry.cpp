@@ -0,0 +1,182 @@
+#include "module_registry.hpp"
+#include "../defs.hpp"
+#include "../log.hpp"
+#include "../utils.hpp"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+namespace ksud {
+
+namespace {
+
+// Identity and change times of a path. The inode catches a directory replaced
+// by rename; ctime and size catch edits that leave mtime where it was.
+struct FileStamp {
+    uint64_t ino = 0;
+    int64_t mtime_ns = 0;
+    int64_t ctime_ns = 0;
+    int64_t size = 0;
+
+    bool operator==(const FileStamp& o) const {
+        return ino == o.ino && mtime_ns == o.mtime_ns && ctime_ns == o.ctime_ns && size == o.size;
+    }
+    bool operator!=(const FileStamp& o) const { return !(*this == o); }
+};
+
+struct CachedModule {
+    ModuleEntry entry;
+    FileStamp dir;
+    FileStamp prop;  // all zero when module.prop is missing
+};
+
+struct Registry {
+    bool built = false;
+    FileStamp root;
+    std::vector<CachedModule> modules;  // sorted by id
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+FileStamp stamp_of(const std::string& path) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0)
+        return {};
+    return {static_cast<uint64_t>(st.st_ino),
+            static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec,
+            static_cast<int64_t>(st.st_ctim.tv_sec) * 1000000000LL + st.st_ctim.tv_nsec,
+            static_cast<int64_t>(st.st_size)};
+}
+
+bool load_cached(const std::string& id, CachedModule& out) {
+    const std::string path = std::string(MODULE_DIR) + id;
+    out.dir = stamp_of(path);
+    if (!read_module_entry(path, id, out.entry))
+        return false;
+    out.prop = out.entry.has("module.prop") ? stamp_of(path + "/module.prop") : FileStamp{};
+    return true;
+}
+
+bool still_fresh(const CachedModule& m) {
+    if (stamp_of(m.entry.path) != m.dir)
+        return false;
+    return !m.entry.has("module.prop") || stamp_of(m.entry.path + "/module.prop") == m.prop;
+}
+
+void rebuild(Registry& r, const FileStamp& root) {
+    std::vector<std::string> ids;
+    if (DIR* dir = opendir(MODULE_DIR)) {
+        while (struct dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] == '.' || entry->d_type != DT_DIR)
+                continue;
+            ids.emplace_back(entry->d_name);
+        }
+        closedir(dir);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    std::vector<CachedModule> modules;
+    modules.reserve(ids.size());
+    size_t reused = 0;
+    for (const auto& id : ids) {
+        auto old = std::lower_bound(
+            r.modules.begin(), r.modules.end(), id,
+            [](const CachedModule& m, const std::string& key) { return m.entry.id < key; });
+        if (old != r.modules.end() && old->entry.id == id && still_fresh(*old)) {
+            modules.push_back(std::move(*old));
+            reused++;
+            continue;
+        }
+        CachedModule m;
+        if (load_cached(id, m))
+            modules.push_back(std::move(m));
+    }
+    r.modules = std::move(modules);
+    r.root = root;
+    LOGD("Module registry: %zu module(s), %zu reused", r.modules.size(), reused);
+}
+
+}  // namespace
+
+std::map<std::string, std::string> parse_module_prop(const std::string& path) {
+    const auto content = read_file(path);
+    return content ? parse_module_prop_text(*content) : std::map<std::string, std::string>();
+}
+
+std::map<std::string, std::string> parse_module_prop_text(const std::string& text) {
+    std::map<std::string, std::string> props;
+    std::istringstream iss(text);
+    std::string line;
+    while (std::getline(iss, line)) {
+        const size_t eq = line.find('=');
+        if (eq != std::string::npos) {
+            const std::string key = trim(line.substr(0, eq));
+            const std::string value = trim(line.substr(eq + 1));
+            props[key] = value;
+        }
+    }
+
+    return props;
+}
+
+bool is_metamodule(const std::map<std::string, std::string>& props) {
+    auto it = props.find("metamodule");
+    if (it == props.end())
+        return false;
+    const std::string val = it->second;
+    return val == "1" || val == "true" || val == "TRUE";
+}
+
+bool read_module_entry(const std::string& path, const std::string& id, ModuleEntry& out) {
+    // One listing answers every marker and script check for this module.
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+        return false;
+    out = ModuleEntry{};
+    out.id = id;
+    out.path = path;
+    while (struct dirent* entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            out.files.emplace(entry->d_name);
+    }
+    closedir(dir);
+
+    if (out.has("module.prop"))
+        out.props = parse_module_prop(path + "/module.prop");
+    out.disabled = out.has(DISABLE_FILE_NAME);
+    out.removing = out.has(REMOVE_FILE_NAME);
+    out.update = out.has(UPDATE_FILE_NAME);
+    out.metamodule = is_metamodule(out.props);
+    return true;
+}
+
+std::vector<ModuleEntry> module_registry() {
+    static std::mutex lock;
+    const std::lock_guard<std::mutex> guard(lock);
+    Registry& r = registry();
+    const FileStamp root = stamp_of(MODULE_DIR);
+    bool stale = !r.built || root != r.root;
+    for (size_t i = 0; !stale && i < r.modules.size(); ++i)
+        stale = !still_fresh(r.modules[i]);
+    if (stale) {
+        rebuild(r, root);
+        r.built = true;
+    }
+
+    std::vector<ModuleEntry> out;
+    out.reserve(r.modules.size());
+    for (const auto& m : r.modules)
+        out.push_back(m.entry);
+    return out;
+}
+
+}  // namespace ksud
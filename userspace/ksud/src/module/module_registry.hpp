@@ -0,0 +1,43 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace ksud {
+
+// One module directory under MODULE_DIR
+struct ModuleEntry {
+    std::string id;    // directory name
+    std::string path;  // MODULE_DIR + id, no trailing slash
+    std::map<std::string, std::string> props;  // module.prop; empty when missing
+    std::set<std::string> files;               // top-level names in the module dir
+    bool disabled{};
+    bool removing{};
+    bool update{};
+    bool metamodule{};
+
+    bool has(const std::string& name) const { return files.count(name) != 0; }
+    bool active() const { return !disabled && !removing; }
+};
+
+// Parse key=value lines (module.prop format)
+std::map<std::string, std::string> parse_module_prop(const std::string& path);
+
+// Same, for module.prop content already in memory (e.g. read from a zip)
+std::map<std::string, std::string> parse_module_prop_text(const std::string& text);
+
+// Check if module props mark a metamodule
+bool is_metamodule(const std::map<std::string, std::string>& props);
+
+// Read one module directory without caching (e.g. under modules_update)
+bool read_module_entry(const std::string& path, const std::string& id, ModuleEntry& out);
+
+// Modules under MODULE_DIR sorted by id. Built once per process; a module is
+// re-read only when the inode, mtime, ctime or size of its directory or
+// module.prop changes, and the list when MODULE_DIR's does. Returned by value so callers may modify modules
+// while iterating; safe to call from several threads.
+std::vector<ModuleEntry> module_registry();
+
+}  // namespace ksud
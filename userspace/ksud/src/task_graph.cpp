@@ -0,0 +1,115 @@
+#include "task_graph.hpp"
+#include "boot_timeline.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+
+namespace ksud {
+
+size_t TaskGraph::add(std::string name, std::function<void()> fn, std::vector<size_t> deps) {
+    const size_t index = tasks_.size();
+    for (const size_t dep : deps) {
+        if (dep < index)
+            tasks_[dep].dependents.push_back(index);
+    }
+    deps.erase(std::remove_if(deps.begin(), deps.end(), [index](size_t d) { return d >= index; }),
+               deps.end());
+    tasks_.push_back({std::move(name), std::move(fn), std::move(deps), {}, 0, 0});
+    return index;
+}
+
+void TaskGraph::run(const std::string& stage, int max_threads) {
+    if (tasks_.empty())
+        return;
+
+    std::mutex lock;
+    std::condition_variable cv;
+    std::set<size_t> ready;  // ordered, so ties start in insertion order
+    std::vector<size_t> pending(tasks_.size());
+    size_t finished = 0;
+    for (size_t i = 0; i < tasks_.size(); ++i) {
+        pending[i] = tasks_[i].deps.size();
+        if (pending[i] == 0)
+            ready.insert(i);
+    }
+
+    auto worker = [&] {
+        std::unique_lock<std::mutex> guard(lock);
+        while (finished < tasks_.size()) {
+            if (ready.empty()) {
+                cv.wait(guard);
+                continue;
+            }
+            const size_t i = *ready.begin();
+            ready.erase(ready.begin());
+            Task& task = tasks_[i];
+
+            guard.unlock();
+            task.start_us = timeline_now_us();
+            task.fn();
+            task.end_us = timeline_now_us();
+            timeline_record(stage, task.name, task.start_us, task.end_us);
+            guard.lock();
+
+            finished++;
+            for (const size_t next : task.dependents) {
+                if (--pending[next] == 0)
+                    ready.insert(next);
+            }
+            cv.notify_all();
+        }
+    };
+
+    // Not capped by the CPU count: most steps wait on storage or the kernel.
+    const int threads = std::max(1, std::min(max_threads, static_cast<int>(tasks_.size())));
+    const int64_t start_us = timeline_now_us();
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; ++i)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool)
+        t.join();
+
+    log_schedule(stage, threads, timeline_now_us() - start_us);
+}
+
+void TaskGraph::log_schedule(const std::string& stage, int threads, int64_t wall_us) const {
+    // Longest chain of durations through the dependencies; deps always come
+    // earlier, so one pass in insertion order is enough.
+    std::vector<int64_t> path_us(tasks_.size());
+    std::vector<size_t> via(tasks_.size(), SIZE_MAX);
+    int64_t serial_us = 0;
+    size_t last = 0;
+    for (size_t i = 0; i < tasks_.size(); ++i) {
+        const Task& task = tasks_[i];
+        int64_t before = 0;
+        for (const size_t dep : task.deps) {
+            if (path_us[dep] > before) {
+                before = path_us[dep];
+                via[i] = dep;
+            }
+        }
+        path_us[i] = before + (task.end_us - task.start_us);
+        serial_us += task.end_us - task.start_us;
+        if (path_us[i] > path_us[last])
+            last = i;
+    }
+
+    std::string chain;
+    for (size_t i = last; i != SIZE_MAX; i = via[i])
+        chain = tasks_[i].name + (chain.empty() ? "" : " > ") + chain;
+
+    LOGI("%s: %zu tasks on %d threads, wall=%lldms, serial sum=%lldms", stage.c_str(),
+         tasks_.size(), threads, static_cast<long long>(wall_us / 1000),
+         static_cast<long long>(serial_us / 1000));
+    LOGI("%s: critical path %lldms: %s", stage.c_str(),
+         static_cast<long long>(path_us[last] / 1000), chain.c_str());
+}
+
+}  // namespace ksud
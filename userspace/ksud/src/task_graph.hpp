@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ksud {
+
+// A fixed set of boot steps with explicit ordering, run on a few threads.
+// A task starts once every task it depends on has finished; tasks that are
+// ready together start in the order they were added.
+class TaskGraph {
+public:
+    // deps are indices returned by earlier add() calls. Returns this task's index.
+    size_t add(std::string name, std::function<void()> fn, std::vector<size_t> deps = {});
+
+    // Run every task on up to max_threads threads (the caller's included) and
+    // return when all are done. Each task is recorded on the boot timeline
+    // under stage, and the wall time, serial sum and critical path are logged.
+    void run(const std::string& stage, int max_threads);
+
+private:
+    struct Task {
+        std::string name;
+        std::function<void()> fn;
+        std::vector<size_t> deps;
+        std::vector<size_t> dependents;
+        int64_t start_us = 0;
+        int64_t end_us = 0;
+    };
+
+    void log_schedule(const std::string& stage, int threads, int64_t wall_us) const;
+
+    std::vector<Task> tasks_;
+};
+
+}  // namespace ksud
@@ -5,29 +5,29 @@
 #include "core/restorecon.hpp"
 #include "defs.hpp"
 #include "log.hpp"
+#include "zip_reader.hpp"
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <algorithm>
 #include <array>
+#include <chrono>
 #include <cerrno>
+#include <csignal>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
-#include <thread>
 #include <vector>
 #ifdef __ANDROID__
 #include <sys/system_properties.h>
 #endif  // #ifdef __ANDROID__
-#ifdef USE_LIBZIP
-#include <zip.h>
-#endif  // #ifdef USE_LIBZIP
 
 namespace ksud {
 
@@ -211,18 +211,35 @@ void switch_cgroup(const char* grp, pid_t pid) {
         ofs << pid;
     }
 }
+
+// Root cgroups a process escapes to, in switch order
+std::vector<const char*> cgroup_escape_dirs() {
+    std::vector<const char*> dirs = {"/acct", "/dev/cg2_bpf", "/sys/fs/cgroup"};
+    auto per_app_memcg = getprop("ro.config.per_app_memcg");
+    if (!per_app_memcg || *per_app_memcg != "false") {
+        dirs.push_back("/dev/memcg/apps");
+    }
+    return dirs;
+}
 }  // namespace
 
 void switch_cgroups() {
     const pid_t pid = getpid();
-    switch_cgroup("/acct", pid);
-    switch_cgroup("/dev/cg2_bpf", pid);
-    switch_cgroup("/sys/fs/cgroup", pid);
+    for (const char* dir : cgroup_escape_dirs()) {
+        switch_cgroup(dir, pid);
+    }
+}
 
-    auto per_app_memcg = getprop("ro.config.per_app_memcg");
-    if (!per_app_memcg || *per_app_memcg != "false") {
-        switch_cgroup("/dev/memcg/apps", pid);
+std::vector<int> open_cgroup_escape_fds() {
+    std::vector<int> fds;
+    for (const char* dir : cgroup_escape_dirs()) {
+        const std::string path = std::string(dir) + "/cgroup.procs";
+        const int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd >= 0) {
+            fds.push_back(fd);
+        }
     }
+    return fds;
 }
 
 void umask(mode_t mask) {  // NOLINT(misc-unused-parameters) forwarded to ::umask
@@ -307,150 +324,157 @@ bool append_file(const std::filesystem::path& path, const std::string& content)
     return true;
 }
 
-ExecResult exec_command(const std::vector<std::string>& args) {
-    ExecResult result{-1, "", ""};
-
-    if (args.empty())
-        return result;
-
-    std::array<int, 2> stdout_pipe{};
-    std::array<int, 2> stderr_pipe{};
-    if (pipe(stdout_pipe.data()) != 0 || pipe(stderr_pipe.data()) != 0) {
-        return result;
-    }
-
-    const pid_t pid = fork();
-    if (pid < 0) {
-        close(stdout_pipe[0]);
-        close(stdout_pipe[1]);
-        close(stderr_pipe[0]);
-        close(stderr_pipe[1]);
-        return result;
-    }
-
-    if (pid == 0) {
-        // Child process
-        close(stdout_pipe[0]);
-        close(stderr_pipe[0]);
-        dup2(stdout_pipe[1], STDOUT_FILENO);
-        dup2(stderr_pipe[1], STDERR_FILENO);
-        close(stdout_pipe[1]);
-        close(stderr_pipe[1]);
+namespace {
 
-        std::vector<char*> c_args;
-        c_args.reserve(args.size() + 1U);
-        for (const auto& arg : args) {
-            c_args.push_back(const_cast<char*>(arg.c_str()));
+// Read both pipes until the child closes them, honouring the capture limit,
+// the streaming callback and the deadline. Closes both fds.
+void collect_output(pid_t pid, int out_fd, int err_fd, const ExecOptions& options,
+                    ExecResult& result) {
+    std::array<pollfd, 2> fds{};
+    fds[0] = {out_fd, POLLIN, 0};
+    fds[1] = {err_fd, POLLIN, 0};
+    const std::array<int, 2> streams = {STDOUT_FILENO, STDERR_FILENO};
+    const std::array<std::string*, 2> sinks = {&result.stdout_str, &result.stderr_str};
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeout_ms);
+
+    std::array<char, 4096> buf{};
+    size_t open_fds = fds.size();
+    while (open_fds > 0) {
+        int wait_ms = -1;
+        if (options.timeout_ms > 0) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) {
+                // Descendants may keep the pipes open; stop reading with the kill.
+                kill(pid, SIGKILL);
+                result.timed_out = true;
+                break;
+            }
+            wait_ms = static_cast<int>(left.count());
         }
-        c_args.push_back(nullptr);
-
-        execvp(c_args[0], c_args.data());
-        _exit(127);
-    }
-
-    // Parent process
-    close(stdout_pipe[1]);
-    close(stderr_pipe[1]);
 
-    // Read stdout
-    std::array<char, 1024> buf{};
-    ssize_t n;
-    while ((n = read(stdout_pipe[0], buf.data(), buf.size())) > 0) {
-        result.stdout_str.append(buf.data(), static_cast<size_t>(n));
+        const int ready = poll(fds.data(), fds.size(), wait_ms);
+        if (ready < 0 && errno != EINTR)
+            break;
+        if (ready <= 0)
+            continue;
+
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (fds[i].fd < 0 || fds[i].revents == 0)
+                continue;
+            const ssize_t n = read(fds[i].fd, buf.data(), buf.size());
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                open_fds--;
+                continue;
+            }
+            std::string* out = sinks[i];
+            if (out->size() < options.max_capture) {
+                out->append(buf.data(),
+                            std::min(static_cast<size_t>(n), options.max_capture - out->size()));
+            }
+            if (options.on_output)
+                options.on_output(streams[i], buf.data(), static_cast<size_t>(n));
+        }
     }
-    close(stdout_pipe[0]);
-
-    // Read stderr
-    while ((n = read(stderr_pipe[0], buf.data(), buf.size())) > 0) {
-        result.stderr_str.append(buf.data(), static_cast<size_t>(n));
+    for (const auto& p : fds) {
+        if (p.fd >= 0)
+            close(p.fd);
     }
-    close(stderr_pipe[0]);
-
-    int status;
-    waitpid(pid, &status, 0);
-    if (WIFEXITED(status)) {
-        result.exit_code = WEXITSTATUS(status);
-    }
-
-    return result;
 }
 
-// NOLINTNEXTLINE(bugprone-easily-swappable-parameters)
-ExecResult exec_command(const std::vector<std::string>& args, const std::string& workdir) {
+}  // namespace
+
+ExecResult exec_command(const std::vector<std::string>& args, const ExecOptions& options) {
     ExecResult result{-1, "", ""};
 
     if (args.empty())
         return result;
 
+    // O_CLOEXEC keeps the pipes out of children spawned concurrently; dup2()
+    // clears it on the copies installed as stdout/stderr.
     std::array<int, 2> stdout_pipe{};
     std::array<int, 2> stderr_pipe{};
-    if (pipe(stdout_pipe.data()) != 0 || pipe(stderr_pipe.data()) != 0) {
+    if (pipe2(stdout_pipe.data(), O_CLOEXEC) != 0) {
         return result;
     }
-
-    const pid_t pid = fork();
-    if (pid < 0) {
+    if (pipe2(stderr_pipe.data(), O_CLOEXEC) != 0) {
         close(stdout_pipe[0]);
         close(stdout_pipe[1]);
-        close(stderr_pipe[0]);
-        close(stderr_pipe[1]);
         return result;
     }
 
+    // The vfork child shares our memory until exec, so everything it uses is
+    // prepared here and it only makes system calls.
+    std::vector<char*> c_args;
+    c_args.reserve(args.size() + 1U);
+    for (const auto& arg : args) {
+        c_args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    c_args.push_back(nullptr);
+    const char* exec_path = options.exec_path.empty() ? nullptr : options.exec_path.c_str();
+    const char* workdir = options.workdir.empty() ? nullptr : options.workdir.c_str();
+    const int stdout_w = stdout_pipe[1];
+    const int stderr_w = stderr_pipe[1];
+
+    // No copy of ksud's page tables: the parent sleeps until the child execs.
+    const pid_t pid = vfork();
     if (pid == 0) {
         // Child process
-        close(stdout_pipe[0]);
-        close(stderr_pipe[0]);
-        dup2(stdout_pipe[1], STDOUT_FILENO);
-        dup2(stderr_pipe[1], STDERR_FILENO);
-        close(stdout_pipe[1]);
-        close(stderr_pipe[1]);
+        dup2(stdout_w, STDOUT_FILENO);
+        dup2(stderr_w, STDERR_FILENO);
 
         // Change to working directory if specified
-        if (!workdir.empty()) {
-            if (chdir(workdir.c_str()) != 0) {
-                _exit(127);
-            }
+        if (workdir != nullptr && chdir(workdir) != 0) {
+            _exit(127);
         }
 
-        std::vector<char*> c_args;
-        c_args.reserve(args.size() + 1U);
-        for (const auto& arg : args) {
-            c_args.push_back(const_cast<char*>(arg.c_str()));
+        if (exec_path != nullptr) {
+            execv(exec_path, c_args.data());
+        } else {
+            execvp(c_args[0], c_args.data());
         }
-        c_args.push_back(nullptr);
-
-        execvp(c_args[0], c_args.data());
         _exit(127);
     }
 
     // Parent process
     close(stdout_pipe[1]);
     close(stderr_pipe[1]);
-
-    // Read stdout
-    std::array<char, 1024> buf{};
-    ssize_t n;
-    while ((n = read(stdout_pipe[0], buf.data(), buf.size())) > 0) {
-        result.stdout_str.append(buf.data(), static_cast<size_t>(n));
+    if (pid < 0) {
+        close(stdout_pipe[0]);
+        close(stderr_pipe[0]);
+        return result;
     }
-    close(stdout_pipe[0]);
 
-    // Read stderr
-    while ((n = read(stderr_pipe[0], buf.data(), buf.size())) > 0) {
-        result.stderr_str.append(buf.data(), static_cast<size_t>(n));
-    }
-    close(stderr_pipe[0]);
+    collect_output(pid, stdout_pipe[0], stderr_pipe[0], options, result);
 
-    int status;
-    waitpid(pid, &status, 0);
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
     if (WIFEXITED(status)) {
         result.exit_code = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        result.term_signal = WTERMSIG(status);
     }
 
     return result;
 }
 
+ExecResult exec_command(const std::vector<std::string>& args) {
+    return exec_command(args, ExecOptions{});
+}
+
+// NOLINTNEXTLINE(bugprone-easily-swappable-parameters)
+ExecResult exec_command(const std::vector<std::string>& args, const std::string& workdir) {
+    ExecOptions options;
+    options.workdir = workdir;
+    return exec_command(args, options);
+}
+
 // NOLINTNEXTLINE(bugprone-easily-swappable-parameters)
 ExecResult exec_command_magiskboot(const std::string& magiskboot_path,
                                    const std::vector<std::string>& sub_args,
@@ -461,71 +485,23 @@ ExecResult exec_command_magiskboot(const std::string& magiskboot_path,
     for (const auto& a : sub_args)
         args.push_back(a);
 
-    ExecResult result{-1, "", ""};
-    if (args.empty())
-        return result;
-
-    std::array<int, 2> stdout_pipe{};
-    std::array<int, 2> stderr_pipe{};
-    if (pipe(stdout_pipe.data()) != 0 || pipe(stderr_pipe.data()) != 0)
-        return result;
-    const pid_t pid = fork();
-    if (pid < 0) {
-        close(stdout_pipe[0]);
-        close(stdout_pipe[1]);
-        close(stderr_pipe[0]);
-        close(stderr_pipe[1]);
-        return result;
-    }
-    if (pid == 0) {
-        close(stdout_pipe[0]);
-        close(stderr_pipe[0]);
-        dup2(stdout_pipe[1], STDOUT_FILENO);
-        dup2(stderr_pipe[1], STDERR_FILENO);
-        close(stdout_pipe[1]);
-        close(stderr_pipe[1]);
-        if (!workdir.empty() && chdir(workdir.c_str()) != 0) {
-            _exit(127);
-        }
-        std::vector<char*> c_args;
-        c_args.reserve(args.size() + 1U);
-        for (const auto& arg : args)
-            c_args.push_back(const_cast<char*>(arg.c_str()));
-        c_args.push_back(nullptr);
-        execv(magiskboot_path.c_str(), c_args.data());
-        _exit(127);
-    }
-    close(stdout_pipe[1]);
-    close(stderr_pipe[1]);
+    ExecOptions options;
+    options.workdir = workdir;
+    options.exec_path = magiskboot_path;
     // Cap capture at 1MB per stream to prevent cache/memory explosion if magiskboot
     // enters an infinite loop writing output.
-    constexpr size_t kMaxCapture = 1024ULL * 1024;
-    auto read_fd_into = [](int fd, std::string* out, bool forward_to_stdout) {
-        std::array<char, 1024> buf{};
-        ssize_t n;
-        while ((n = read(fd, buf.data(), buf.size())) > 0) {
-            if (out->size() < kMaxCapture) {
-                const size_t to_append =
-                    std::min(static_cast<size_t>(n), kMaxCapture - out->size());
-                out->append(buf.data(), to_append);
-            }
-            if (forward_to_stdout && n > 0) {
-                (void)fwrite(buf.data(), 1, static_cast<size_t>(n), stdout);
-                (void)fflush(stdout);
-            }
+    options.max_capture = 1024ULL * 1024;
+    // Show magiskboot's diagnostics as they happen
+    options.on_output = [](int fd, const char* data, size_t len) {
+        if (fd == STDERR_FILENO) {
+            (void)fwrite(data, 1, len, stdout);
+            (void)fflush(stdout);
         }
-        close(fd);
     };
-    std::thread t_stdout(read_fd_into, stdout_pipe[0], &result.stdout_str, false);
-    std::thread t_stderr(read_fd_into, stderr_pipe[0], &result.stderr_str, true);
-    int status;
-    waitpid(pid, &status, 0);
-    t_stdout.join();
-    t_stderr.join();
-    if (WIFEXITED(status)) {
-        result.exit_code = WEXITSTATUS(status);
-    } else if (WIFSIGNALED(status)) {
-        const int sig = WTERMSIG(status);
+
+    ExecResult result = exec_command(args, options);
+    if (result.term_signal != 0) {
+        const int sig = result.term_signal;
         result.exit_code = 128 + sig;
         result.stderr_str.append("magiskboot terminated by signal ");
         result.stderr_str.append(std::to_string(sig));
@@ -544,19 +520,19 @@ int exec_command_async(const std::vector<std::string>& args) {
     if (args.empty())
         return -1;
 
-    const pid_t pid = fork();
+    std::vector<char*> c_args;
+    c_args.reserve(args.size() + 1U);
+    for (const auto& arg : args) {
+        c_args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    c_args.push_back(nullptr);
+
+    const pid_t pid = vfork();
     if (pid < 0)
         return -1;
 
     if (pid == 0) {
         // Child process
-        std::vector<char*> c_args;
-        c_args.reserve(args.size() + 1U);
-        for (const auto& arg : args) {
-            c_args.push_back(const_cast<char*>(arg.c_str()));
-        }
-        c_args.push_back(nullptr);
-
         execvp(c_args[0], c_args.data());
         _exit(127);
     }
@@ -714,33 +690,12 @@ int uninstall(const std::optional<std::string>& magiskboot_path) {
 }
 
 uint64_t get_zip_uncompressed_size(const std::string& zip_path) {
-#ifdef USE_LIBZIP
-    zip_t* za = zip_open(zip_path.c_str(), ZIP_RDONLY, nullptr);
-    if (!za) {
-        LOGE("Failed to open ZIP: %s", zip_path.c_str());
-        return 0;
-    }
-
-    uint64_t total = 0;
-    zip_int64_t num_entries = zip_get_num_entries(za, 0);
-
-    for (zip_int64_t i = 0; i < num_entries; i++) {
-        zip_stat_t stat;
-        if (zip_stat_index(za, i, 0, &stat) == 0) {
-            total += stat.size;
-        }
-    }
-
-    zip_close(za);
-    return total;
-#else
-    // Fallback: estimate based on file size * 2
-    std::ifstream ifs(zip_path, std::ios::binary | std::ios::ate);
-    if (!ifs) {
+    ZipReader reader(zip_path);
+    if (!reader.valid()) {
+        LOGE("Failed to open ZIP %s: %s", zip_path.c_str(), reader.error().c_str());
         return 0;
     }
-    return static_cast<uint64_t>(ifs.tellg()) * 2;
-#endif  // #ifdef USE_LIBZIP
+    return reader.uncompressed_size();
 }
 
 bool parse_uint32(const std::string& s, uint32_t* out) {
@@ -4,6 +4,7 @@
 #include <functional>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace ksud {
 
@@ -21,6 +22,9 @@ bool is_safe_mode();
 // Process utilities
 bool switch_mnt_ns(pid_t pid);
 void switch_cgroups();
+// cgroup.procs fds for the cgroups switch_cgroups() uses. Writing "0" to each
+// moves the writer, so a vfork child can escape without allocating.
+std::vector<int> open_cgroup_escape_fds();
 void umask(mode_t mask);
 
 // Magisk detection
@@ -47,10 +51,22 @@ bool append_file(const std::filesystem::path& path, const std::string& content);
 
 // Command execution
 struct ExecResult {
-    int exit_code;
+    int exit_code;  // -1 unless the child exited normally
     std::string stdout_str;
     std::string stderr_str;
+    int term_signal = 0;     // signal that ended the child, 0 if it exited
+    bool timed_out = false;  // killed after ExecOptions::timeout_ms
 };
+struct ExecOptions {
+    std::string workdir;
+    std::string exec_path;  // run this file instead of searching PATH for args[0]
+    size_t max_capture = 4ULL * 1024 * 1024;  // bytes kept per stream; the rest is drained
+    int timeout_ms = 0;                       // SIGKILL the child after this long; 0 = never
+    // Sees every chunk as it arrives, including what max_capture drops.
+    std::function<void(int fd, const char* data, size_t len)> on_output;
+};
+// Spawns with vfork() and reads stdout/stderr as they are produced.
+ExecResult exec_command(const std::vector<std::string>& args, const ExecOptions& options);
 ExecResult exec_command(const std::vector<std::string>& args);
 ExecResult exec_command(const std::vector<std::string>& args, const std::string& workdir);
 /** Run magiskboot binary (path may be multi-call ksud); argv[0] is set to "magiskboot". */
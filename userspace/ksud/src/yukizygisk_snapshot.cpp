@@ -11,18 +11,26 @@
 
 #include <elf.h>
 #include <fcntl.h>
+#include <linux/fs.h>
+#include <mbedtls/sha256.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <array>
 #include <cctype>
 #include <cerrno>
+#include <cinttypes>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <map>
+#include <sstream>
 #include <string>
 #include <system_error>
 #include <vector>
@@ -36,6 +44,9 @@ using yukizygisk::native::NativeModule;
 
 constexpr const char* kSnapshotDirName = "yukizygisk";
 constexpr const char* kManifestName = "native_snapshot.bin";
+constexpr const char* kSourcesName = ".snapshot_sources";
+constexpr const char* kSourcesHeader = "snapshot-sources v1";
+constexpr const char* kAssetSourcePrefix = "asset:";
 constexpr const char* kModulesDirName = "modules";
 constexpr const char* kLoaderName = "libyukilinker.so";
 constexpr const char* kNativeCoreName = "libyukizncore.so";
@@ -76,31 +87,323 @@ void remove_snapshot_dir(const fs::path& base) {
     fs::remove_all(base / kSnapshotDirName, ec);
 }
 
+// Clone, copy_file_range, or read/write, whichever the filesystems allow.
 bool copy_regular_file(const fs::path& src, const fs::path& dst) {
-    std::ifstream const in(src, std::ios::binary);
-    if (!in)
+    const int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
         return false;
-    std::ofstream out(dst, std::ios::binary | std::ios::trunc);
-    if (!out)
+    const int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        close(in);
         return false;
-    out << in.rdbuf();
-    out.flush();
-    return static_cast<bool>(out);
+    }
+
+    bool ok = ioctl(out, FICLONE, in) == 0;
+    bool kernel_copy = !ok;
+    while (kernel_copy) {
+        const ssize_t n = syscall(__NR_copy_file_range, in, nullptr, out, nullptr,
+                                  static_cast<size_t>(1) << 30, 0U);
+        if (n == 0) {
+            ok = true;
+            break;
+        }
+        if (n < 0) {
+            // Old kernel or cross-device: redo the whole file the slow way.
+            kernel_copy = false;
+            ok = ftruncate(out, 0) == 0 && lseek(in, 0, SEEK_SET) == 0 &&
+                 lseek(out, 0, SEEK_SET) == 0;
+            if (!ok)
+                break;
+            std::array<char, 64 * 1024> buf{};
+            ssize_t r;
+            while ((r = read(in, buf.data(), buf.size())) > 0) {
+                if (write(out, buf.data(), static_cast<size_t>(r)) != r) {
+                    ok = false;
+                    break;
+                }
+            }
+            ok = ok && r == 0;
+        }
+    }
+
+    close(in);
+    return close(out) == 0 && ok;
+}
+
+// Same 64-bit sha256 prefix the embedded assets carry, so a file and the
+// asset it came from compare equal.
+bool hash_file(const fs::path& path, uint64_t& hash) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    std::array<unsigned char, 64 * 1024> buf{};
+    ssize_t n;
+    while ((n = read(fd, buf.data(), buf.size())) > 0)
+        mbedtls_sha256_update(&ctx, buf.data(), static_cast<size_t>(n));
+    close(fd);
+    std::array<unsigned char, 32> digest{};
+    mbedtls_sha256_finish(&ctx, digest.data());
+    mbedtls_sha256_free(&ctx);
+    if (n < 0)
+        return false;
+    hash = 0;
+    for (size_t i = 0; i < 8; ++i)
+        hash = (hash << 8) | digest[i];
+    return true;
+}
+
+struct FileStamp {
+    uint64_t size = 0;
+    uint64_t ino = 0;
+    int64_t mtime_ns = 0;
+
+    bool operator==(const FileStamp& o) const {
+        return size == o.size && ino == o.ino && mtime_ns == o.mtime_ns;
+    }
+    bool operator!=(const FileStamp& o) const { return !(*this == o); }
+};
+
+bool stamp_file(const fs::path& path, FileStamp& out, bool follow) {
+    struct stat st{};
+    if ((follow ? stat(path.c_str(), &st) : lstat(path.c_str(), &st)) != 0 ||
+        !S_ISREG(st.st_mode))
+        return false;
+    out.size = static_cast<uint64_t>(st.st_size);
+    out.ino = static_cast<uint64_t>(st.st_ino);
+    out.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    return true;
+}
+
+// What one staged file was made from, so the next refresh can tell whether
+// it still matches its source without reading either.
+struct StagedFile {
+    uint64_t hash = 0;
+    FileStamp dst;
+    FileStamp src;         // zero for embedded assets
+    std::string src_path;  // kAssetSourcePrefix + name for embedded assets
+};
+
+// Sidecar of the snapshot dir: staged files by name relative to it, and the
+// linker symbol offsets with the linker they were resolved from.
+struct SnapshotSources {
+    std::map<std::string, StagedFile> files;
+    FileStamp linker;
+    uint64_t dlopen_offset = 0;
+    uint64_t dlsym_offset = 0;
+};
+
+SnapshotSources load_sources(const fs::path& path) {
+    SnapshotSources out;
+    const auto content = read_file(path.string());
+    if (!content)
+        return out;
+    std::istringstream in(*content);
+    std::string line;
+    if (!std::getline(in, line) || line != kSourcesHeader)
+        return out;  // unknown format: everything is restaged once
+    while (std::getline(in, line)) {
+        char name[256] = {};
+        StagedFile f;
+        int src_off = 0;
+        if (sscanf(line.c_str(),
+                   "linker %" SCNu64 " %" SCNu64 " %" SCNd64 " %" SCNx64 " %" SCNx64,
+                   &out.linker.size, &out.linker.ino, &out.linker.mtime_ns, &out.dlopen_offset,
+                   &out.dlsym_offset) == 5) {
+            continue;
+        }
+        if (sscanf(line.c_str(),
+                   "file %255s %" SCNx64 " %" SCNu64 " %" SCNu64 " %" SCNd64 " %" SCNu64
+                   " %" SCNu64 " %" SCNd64 " %n",
+                   name, &f.hash, &f.dst.size, &f.dst.ino, &f.dst.mtime_ns, &f.src.size,
+                   &f.src.ino, &f.src.mtime_ns, &src_off) == 8 &&
+            src_off > 0) {
+            f.src_path = line.substr(static_cast<size_t>(src_off));
+            out.files[name] = f;
+        }
+    }
+    return out;
+}
+
+std::string format_sources(const SnapshotSources& sources) {
+    std::string out = std::string(kSourcesHeader) + "\n";
+    char line[256];
+    snprintf(line, sizeof(line),
+             "linker %" PRIu64 " %" PRIu64 " %" PRId64 " %" PRIx64 " %" PRIx64 "\n",
+             sources.linker.size, sources.linker.ino, sources.linker.mtime_ns,
+             sources.dlopen_offset, sources.dlsym_offset);
+    out += line;
+    for (const auto& [name, f] : sources.files) {
+        snprintf(line, sizeof(line),
+                 "%016" PRIx64 " %" PRIu64 " %" PRIu64 " %" PRId64 " %" PRIu64 " %" PRIu64
+                 " %" PRId64 " ",
+                 f.hash, f.dst.size, f.dst.ino, f.dst.mtime_ns, f.src.size, f.src.ino,
+                 f.src.mtime_ns);
+        out += "file " + name + " " + line + f.src_path + "\n";
+    }
+    return out;
 }
 
-bool stage_asset_or_file(const char* asset, const fs::path& fallback, const fs::path& dst) {
-    if (copy_asset_to_file(asset, dst.string())) {
-        chmod(dst.c_str(), 0644);
-        (void)lsetfilecon(dst, kMetadataFileCon);
+// Write path only when its content differs, through a temp file and rename
+// so readers never see a partial file. Sets changed when it wrote.
+bool replace_if_changed(const fs::path& path, const std::string& content, bool& changed) {
+    changed = false;
+    const auto old = read_file(path.string());
+    if (old && *old == content)
         return true;
+    const fs::path tmp = path.string() + ".tmp";
+    if (!write_file(tmp, content)) {
+        unlink(tmp.c_str());
+        return false;
     }
-    if (!copy_regular_file(fallback, dst))
+    chmod(tmp.c_str(), 0644);
+    (void)lsetfilecon(tmp, kMetadataFileCon);
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
         return false;
-    chmod(dst.c_str(), 0644);
-    (void)lsetfilecon(dst, kMetadataFileCon);
+    }
+    changed = true;
     return true;
 }
 
+// The linker treats two paths with the same dev/ino as one library, so a
+// shared object must never share an inode with another staged name.
+bool is_shared_object(const std::string& name) {
+    return name.ends_with(".so");
+}
+
+// Brings the snapshot dir to a new set of files while touching as little as
+// possible: a name whose source is unchanged is kept, content already staged
+// under another name is hard-linked (cloned for shared objects), and only new
+// content is copied.
+class SnapshotStager {
+public:
+    SnapshotStager(fs::path dir, const SnapshotSources& previous)
+        : dir_(std::move(dir)), previous_(previous.files) {
+        for (const auto& [name, f] : previous_) {
+            if (intact(name, f))
+                by_hash_.emplace(f.hash, name);
+        }
+    }
+
+    // name gets the embedded asset, or fallback when it is not embedded
+    bool stage_asset(const char* asset, const fs::path& fallback, const std::string& name) {
+        uint64_t hash = 0;
+        size_t size = 0;
+        if (!get_asset_stamp(asset, hash, size))
+            return stage_file(fallback, name);
+
+        StagedFile f;
+        f.hash = hash;
+        f.src_path = std::string(kAssetSourcePrefix) + asset;
+        if (keep(name, f))
+            return true;
+        return place(name, f, [&](const fs::path& tmp) {
+            return copy_asset_to_file(asset, tmp.string());
+        });
+    }
+
+    bool stage_file(const fs::path& src, const std::string& name) {
+        StagedFile f;
+        f.src_path = src.string();
+        if (!stamp_file(src, f.src, true))
+            return false;
+
+        auto old = previous_.find(name);
+        if (old != previous_.end() && old->second.src_path == f.src_path &&
+            old->second.src == f.src) {
+            f.hash = old->second.hash;
+            if (keep(name, f))
+                return true;
+        }
+        if (!hash_file(src, f.hash))
+            return false;
+        if (keep(name, f))
+            return true;
+        return place(name, f, [&](const fs::path& tmp) { return copy_regular_file(src, tmp); });
+    }
+
+    // Drop files under subdir that were not staged this round
+    void prune(const std::string& subdir) {
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(dir_ / subdir, ec)) {
+            const std::string name = subdir + "/" + entry.path().filename().string();
+            if (staged_.count(name) == 0)
+                fs::remove(entry.path(), ec);
+        }
+    }
+
+    const std::map<std::string, StagedFile>& staged() const { return staged_; }
+    size_t copied() const { return copied_; }
+    size_t linked() const { return linked_; }
+    size_t kept() const { return kept_; }
+
+private:
+    bool intact(const std::string& name, const StagedFile& f) const {
+        FileStamp now;
+        return stamp_file(dir_ / name, now, false) && now == f.dst;
+    }
+
+    // The file already under name has f's content: just record it.
+    bool keep(const std::string& name, StagedFile& f) {
+        auto old = previous_.find(name);
+        if (old == previous_.end() || old->second.hash != f.hash || !intact(name, old->second))
+            return false;
+        struct stat st{};
+        if (is_shared_object(name) &&
+            (lstat((dir_ / name).c_str(), &st) != 0 || st.st_nlink != 1))
+            return false;
+        f.dst = old->second.dst;
+        staged_[name] = f;
+        kept_++;
+        return true;
+    }
+
+    template <typename Produce>
+    bool place(const std::string& name, StagedFile& f, Produce produce) {
+        const fs::path dst = dir_ / name;
+        const fs::path tmp = dst.string() + ".tmp";
+        unlink(tmp.c_str());
+
+        bool linked = false;
+        auto same = by_hash_.find(f.hash);
+        const bool shared = same != by_hash_.end() && same->second != name;
+        if (shared && !is_shared_object(name))
+            linked = link((dir_ / same->second).c_str(), tmp.c_str()) == 0;
+        if (!linked) {
+            if (!(shared && copy_regular_file(dir_ / same->second, tmp)) && !produce(tmp)) {
+                unlink(tmp.c_str());
+                return false;
+            }
+            chmod(tmp.c_str(), 0644);
+            (void)lsetfilecon(tmp, kMetadataFileCon);
+        }
+        if (rename(tmp.c_str(), dst.c_str()) != 0 || !stamp_file(dst, f.dst, false)) {
+            unlink(tmp.c_str());
+            return false;
+        }
+
+        // name no longer holds whatever it held before
+        for (auto it = by_hash_.begin(); it != by_hash_.end();) {
+            it = it->second == name ? by_hash_.erase(it) : std::next(it);
+        }
+        by_hash_.emplace(f.hash, name);
+        staged_[name] = f;
+        (linked ? linked_ : copied_)++;
+        return true;
+    }
+
+    fs::path dir_;
+    std::map<std::string, StagedFile> previous_;
+    std::map<std::string, StagedFile> staged_;
+    std::multimap<uint64_t, std::string> by_hash_;  // names holding intact content
+    size_t copied_ = 0;
+    size_t linked_ = 0;
+    size_t kept_ = 0;
+};
+
 uint64_t resolve_linker_sym(const char* path, const char* want) {
     int const fd = open(path, O_RDONLY | O_CLOEXEC);
     if (fd < 0)
@@ -230,8 +533,8 @@ void fill_cstr(char* dst, size_t dst_size, const std::string& src) {
     dst[copy_size] = '\0';
 }
 
-bool stage_module_entry(const NativeModule& m, size_t idx, const fs::path& module_dir,
-                        yz_early_native_entry* entry) {
+bool stage_module_entry(const NativeModule& m, size_t idx, const fs::path& snapshot_dir,
+                        SnapshotStager& stager, yz_early_native_entry* entry) {
     char file_name[128];
     const int file_name_len =
         snprintf(file_name, sizeof(file_name), "%03zu-%s.so", idx, m.module_id.c_str());
@@ -239,14 +542,13 @@ bool stage_module_entry(const NativeModule& m, size_t idx, const fs::path& modul
         LOGW("yukizygisk early: module filename too long for %s", m.module_id.c_str());
         return false;
     }
-    fs::path const dst = module_dir / file_name;
-    if (!copy_regular_file(m.lib_path, dst)) {
+    const std::string name = std::string(kModulesDirName) + "/" + file_name;
+    if (!stager.stage_file(m.lib_path, name)) {
         LOGW("yukizygisk early: failed to copy native module %s from %s", m.module_id.c_str(),
              m.lib_path.c_str());
         return false;
     }
-    chmod(dst.c_str(), 0644);
-    (void)lsetfilecon(dst, kMetadataFileCon);
+    fs::path const dst = snapshot_dir / name;
 
     *entry = {};
     entry->target_type = m.target_type;
@@ -256,16 +558,12 @@ bool stage_module_entry(const NativeModule& m, size_t idx, const fs::path& modul
     return true;
 }
 
-bool write_manifest(const fs::path& path, const yz_early_native_snapshot_header& header,
-                    const std::vector<yz_early_native_entry>& entries) {
-    std::ofstream out(path, std::ios::binary | std::ios::trunc);
-    if (!out)
-        return false;
-    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+std::string encode_manifest(const yz_early_native_snapshot_header& header,
+                            const std::vector<yz_early_native_entry>& entries) {
+    std::string out(reinterpret_cast<const char*>(&header), sizeof(header));
     for (const auto& entry : entries)
-        out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
-    out.flush();
-    return static_cast<bool>(out);
+        out.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    return out;
 }
 
 bool yukizygisk_enabled_for_next_boot() {
@@ -292,8 +590,8 @@ int refresh_yukizygisk_early_snapshot() {
     const fs::path preinit_dir = preinit_ksu_dir();
     const fs::path snapshot_dir = preinit_dir / kSnapshotDirName;
     const fs::path module_dir = snapshot_dir / kModulesDirName;
-    const fs::path manifest_tmp = snapshot_dir / ".native_snapshot.tmp";
     const fs::path manifest = snapshot_dir / kManifestName;
+    const fs::path sources_path = snapshot_dir / kSourcesName;
     std::error_code ec;
 
     fs::create_directories(module_dir, ec);
@@ -302,17 +600,11 @@ int refresh_yukizygisk_early_snapshot() {
         return 1;
     }
 
-    fs::remove_all(module_dir, ec);
-    fs::create_directories(module_dir, ec);
-    if (ec) {
-        LOGW("yukizygisk early: failed to reset %s: %s", module_dir.c_str(), ec.message().c_str());
-        return 1;
-    }
-
-    const fs::path loader_path = snapshot_dir / kLoaderName;
-    const fs::path native_core_path = snapshot_dir / kNativeCoreName;
-    if (!stage_asset_or_file(kLoaderName, ZYUKILINKER_PATH, loader_path) ||
-        !stage_asset_or_file(kNativeCoreName, ZNCORE_PATH, native_core_path)) {
+    // Files whose source is unchanged since the last refresh stay as they are.
+    const SnapshotSources previous = load_sources(sources_path);
+    SnapshotStager stager(snapshot_dir, previous);
+    if (!stager.stage_asset(kLoaderName, ZYUKILINKER_PATH, kLoaderName) ||
+        !stager.stage_asset(kNativeCoreName, ZNCORE_PATH, kNativeCoreName)) {
         clear_yukizygisk_early_snapshot();
         LOGW("yukizygisk early: payload unavailable, snapshot cleared");
         return 1;
@@ -323,9 +615,10 @@ int refresh_yukizygisk_early_snapshot() {
     entries.reserve(modules.size());
     for (size_t i = 0; i < modules.size(); i++) {
         yz_early_native_entry entry{};
-        if (stage_module_entry(modules[i], i, module_dir, &entry))
+        if (stage_module_entry(modules[i], i, snapshot_dir, stager, &entry))
             entries.push_back(entry);
     }
+    stager.prune(kModulesDirName);
 
     static const char* const kDlopen[] = {
         "__loader_android_dlopen_ext",
@@ -336,8 +629,21 @@ int refresh_yukizygisk_early_snapshot() {
         "dlsym",
     };
 
-    struct stat linker_stat{};
-    bool const linker_stat_ok = entries.empty() || stat(kSystemLinker64, &linker_stat) == 0;
+    SnapshotSources sources;
+    sources.files = stager.staged();
+    bool const linker_stat_ok =
+        entries.empty() || stamp_file(kSystemLinker64, sources.linker, true);
+    if (!entries.empty() && linker_stat_ok) {
+        // Parsing linker64's sections is only needed after an OTA changed it.
+        if (sources.linker == previous.linker && previous.dlopen_offset != 0 &&
+            previous.dlsym_offset != 0) {
+            sources.dlopen_offset = previous.dlopen_offset;
+            sources.dlsym_offset = previous.dlsym_offset;
+        } else {
+            sources.dlopen_offset = resolve_first(kDlopen, 2);
+            sources.dlsym_offset = resolve_first(kDlsym, 2);
+        }
+    }
 
     yz_early_native_snapshot_header header{};
     header.magic = YZ_EARLY_NATIVE_MAGIC;
@@ -346,9 +652,9 @@ int refresh_yukizygisk_early_snapshot() {
     header.entry_size = sizeof(yz_early_native_entry);
     header.flags = YZ_EARLY_NATIVE_FLAG_ENABLED;
     header.count = static_cast<uint32_t>(entries.size());
-    header.dlopen_offset = entries.empty() ? 0 : resolve_first(kDlopen, 2);
-    header.dlsym_offset = entries.empty() ? 0 : resolve_first(kDlsym, 2);
-    header.linker_size = entries.empty() ? 0 : static_cast<uint64_t>(linker_stat.st_size);
+    header.dlopen_offset = entries.empty() ? 0 : sources.dlopen_offset;
+    header.dlsym_offset = entries.empty() ? 0 : sources.dlsym_offset;
+    header.linker_size = entries.empty() ? 0 : sources.linker.size;
 
     if (!entries.empty() && (!linker_stat_ok || header.dlopen_offset == 0 ||
                              header.dlsym_offset == 0 || header.linker_size == 0)) {
@@ -357,26 +663,22 @@ int refresh_yukizygisk_early_snapshot() {
         return 1;
     }
 
-    if (!write_manifest(manifest_tmp, header, entries)) {
-        fs::remove(manifest_tmp, ec);
-        LOGW("yukizygisk early: failed to write %s", manifest_tmp.c_str());
-        return 1;
-    }
-
-    chmod(manifest_tmp.c_str(), 0644);
-    (void)lsetfilecon(manifest_tmp, kMetadataFileCon);
-    fs::rename(manifest_tmp, manifest, ec);
-    if (ec) {
-        fs::remove(manifest_tmp, ec);
-        LOGW("yukizygisk early: failed to rename snapshot: %s", ec.message().c_str());
+    bool manifest_changed = false;
+    if (!replace_if_changed(manifest, encode_manifest(header, entries), manifest_changed)) {
+        LOGW("yukizygisk early: failed to write %s", manifest.c_str());
         return 1;
     }
+    bool sources_changed = false;
+    if (!replace_if_changed(sources_path, format_sources(sources), sources_changed))
+        LOGW("yukizygisk early: failed to write %s", sources_path.c_str());
 
     const fs::path stale_dir =
         (preinit_dir == PREINIT_DIR_WATCHDOG) ? PREINIT_DIR_DEFAULT : PREINIT_DIR_WATCHDOG;
     remove_snapshot_dir(stale_dir);
 
-    LOGI("yukizygisk early: snapshot refreshed modules=%zu", entries.size());
+    LOGI("yukizygisk early: snapshot refreshed modules=%zu copied=%zu linked=%zu kept=%zu%s",
+         entries.size(), stager.copied(), stager.linked(), stager.kept(),
+         manifest_changed || sources_changed ? "" : " (unchanged)");
     return 0;
 }
 
@@ -0,0 +1,104 @@
+#include "zip_reader.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace ksud {
+
+ZipReader::ZipReader(const std::string& path) : fd_(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+    if (fd_ < 0) {
+        error_ = "Cannot open package: " + std::string(strerror(errno));
+        return;
+    }
+
+    struct stat stat_buffer{};
+    if (fstat(fd_, &stat_buffer) != 0 || !S_ISREG(stat_buffer.st_mode) ||
+        stat_buffer.st_size <= 0) {
+        error_ = "Package is not a non-empty regular file";
+        return;
+    }
+
+    archive_.m_pRead = &ZipReader::read_at;
+    archive_.m_pIO_opaque = this;
+    if (!mz_zip_reader_init(&archive_, static_cast<mz_uint64>(stat_buffer.st_size), 0)) {
+        error_ = std::string("Invalid ZIP archive: ") +
+                 mz_zip_get_error_string(mz_zip_get_last_error(&archive_));
+        return;
+    }
+    initialized_ = true;
+}
+
+ZipReader::~ZipReader() {
+    if (initialized_)
+        mz_zip_reader_end(&archive_);
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+uint64_t ZipReader::uncompressed_size() {
+    uint64_t total = 0;
+    if (!initialized_)
+        return total;
+    const mz_uint count = mz_zip_reader_get_num_files(&archive_);
+    for (mz_uint index = 0; index < count; ++index) {
+        mz_zip_archive_file_stat stat{};
+        if (mz_zip_reader_file_stat(&archive_, index, &stat))
+            total += stat.m_uncomp_size;
+    }
+    return total;
+}
+
+std::optional<std::string> ZipReader::read_entry(const std::string& name, size_t max_size,
+                                                 std::string* error) {
+    if (!initialized_) {
+        *error = error_;
+        return std::nullopt;
+    }
+    const int index = mz_zip_reader_locate_file(&archive_, name.c_str(), nullptr,
+                                                MZ_ZIP_FLAG_CASE_SENSITIVE);
+    if (index < 0) {
+        *error = name + " not found in archive";
+        return std::nullopt;
+    }
+    mz_zip_archive_file_stat stat{};
+    if (!mz_zip_reader_file_stat(&archive_, static_cast<mz_uint>(index), &stat)) {
+        *error = "Cannot read archive entry metadata";
+        return std::nullopt;
+    }
+    if (stat.m_uncomp_size > max_size) {
+        *error = name + " is too large";
+        return std::nullopt;
+    }
+
+    std::string content(static_cast<size_t>(stat.m_uncomp_size), '\0');
+    if (!content.empty() &&
+        !mz_zip_reader_extract_to_mem(&archive_, static_cast<mz_uint>(index), content.data(),
+                                      content.size(), 0)) {
+        *error = std::string("Cannot extract ") + name + ": " +
+                 mz_zip_get_error_string(mz_zip_get_last_error(&archive_));
+        return std::nullopt;
+    }
+    return content;
+}
+
+size_t ZipReader::read_at(void* opaque, mz_uint64 offset, void* buffer, size_t size) {
+    auto* self = static_cast<ZipReader*>(opaque);
+    size_t total = 0;
+    while (total < size) {
+        const ssize_t count = pread(self->fd_, static_cast<char*>(buffer) + total, size - total,
+                                    static_cast<off_t>(offset + total));
+        if (count > 0) {
+            total += static_cast<size_t>(count);
+            continue;
+        }
+        if (count < 0 && errno == EINTR)
+            continue;
+        break;
+    }
+    return total;
+}
+
+}  // namespace ksud
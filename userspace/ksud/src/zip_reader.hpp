@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#define MINIZ_HEADER_FILE_ONLY
+#include "miniz.h"
+
+namespace ksud {
+
+// Read-only ZIP archive backed by pread() on the package itself: the central
+// directory is indexed once and entries are inflated on demand, nothing is
+// extracted to disk.
+class ZipReader {
+public:
+    explicit ZipReader(const std::string& path);
+    ~ZipReader();
+
+    ZipReader(const ZipReader&) = delete;
+    ZipReader& operator=(const ZipReader&) = delete;
+    ZipReader(ZipReader&&) = delete;
+    ZipReader& operator=(ZipReader&&) = delete;
+
+    [[nodiscard]] bool valid() const { return initialized_; }
+    [[nodiscard]] const std::string& error() const { return error_; }
+    mz_zip_archive* archive() { return &archive_; }
+
+    // Sum of the uncompressed sizes in the central directory
+    uint64_t uncompressed_size();
+    // Content of the entry called name; nullopt if it is missing, larger than
+    // max_size or fails to inflate (error says which).
+    std::optional<std::string> read_entry(const std::string& name, size_t max_size,
+                                          std::string* error);
+
+private:
+    static size_t read_at(void* opaque, mz_uint64 offset, void* buffer, size_t size);
+
+    int fd_ = -1;
+    bool initialized_ = false;
+    mz_zip_archive archive_{};
+    std::string error_;
+};
+
+}  // namespace ksud
@@ -6,6 +6,7 @@
 
 #include "loader.hpp"
 #include "log.hpp"
+#include "userspace/common/kallsyms.hpp"
 
 #include <cerrno>
 #include <cstdint>
@@ -14,7 +15,7 @@
 #include <fstream>
 #include <sstream>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 #include <elf.h>
@@ -64,50 +65,54 @@ private:
 };
 
 /**
- * Parse /proc/kallsyms to get kernel symbol addresses
+ * Resolve the module's undefined symbols from /proc/kallsyms and patch them
+ * to absolute addresses
  */
-std::unordered_map<std::string, uint64_t> parse_kallsyms() {
-    const KptrGuard guard;
-
-    std::unordered_map<std::string, uint64_t> symbols;
-
-    std::ifstream ifs("/proc/kallsyms");
-    if (!ifs.is_open()) {
-        KLOGE("Cannot open /proc/kallsyms");
-        return symbols;
+bool patch_undefined_symbols(std::vector<uint8_t>& buffer) {
+    std::vector<kallsyms::UndefinedSymbol<Elf64_Sym>> undefined;
+    const char* error = kallsyms::collect_undefined_symbols<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>(
+        buffer.data(), buffer.size(), &undefined);
+    if (error != nullptr) {
+        KLOGE("%s", error);
+        return false;
     }
 
-    std::string line;
-    while (std::getline(ifs, line)) {
-        std::istringstream iss(line);
-        std::string addr_str;
-        std::string type;
-        std::string name;
+    kallsyms::Resolver resolver;
+    std::vector<size_t> slots;
+    slots.reserve(undefined.size());
+    for (const auto& entry : undefined) {
+        slots.push_back(resolver.want(entry.name));
+    }
 
-        if (!(iss >> addr_str >> type >> name)) {
-            continue;
+    {
+        const KptrGuard guard;
+        if (!resolver.resolve("/proc/kallsyms")) {
+            KLOGE("Cannot read /proc/kallsyms: %s", strerror(errno));
+            return false;
         }
+    }
+    if (resolver.size() != 0 && resolver.stats().lines == 0) {
+        KLOGE("Cannot parse kallsyms");
+        return false;
+    }
+    KLOGI("Resolved %zu/%zu symbols from %zu kallsyms lines", resolver.size() - resolver.missing(),
+          resolver.size(), resolver.stats().lines);
 
-        uint64_t addr = 0;
-        try {
-            addr = std::stoull(addr_str, nullptr, 16);
-        } catch (...) {
+    for (size_t i = 0; i < undefined.size(); i++) {
+        if (!resolver.found(slots[i])) {
             continue;
         }
-
-        // Strip version suffixes like "$..." or ".llvm...."
-        auto pos = name.find('$');
-        if (pos == std::string::npos) {
-            pos = name.find(".llvm.");
-        }
-        if (pos != std::string::npos) {
-            name = name.substr(0, pos);
+        undefined[i].sym->st_shndx = SHN_ABS;
+        undefined[i].sym->st_value = resolver.address(slots[i]);
+    }
+    for (size_t slot = 0; slot < resolver.size(); slot++) {
+        if (!resolver.found(slot)) {
+            const std::string_view name = resolver.name(slot);
+            KLOGW("Cannot find symbol: %.*s", static_cast<int>(name.size()), name.data());
         }
-
-        symbols[name] = addr;
     }
 
-    return symbols;
+    return true;
 }
 
 /**
@@ -174,67 +179,10 @@ bool load_module(const char* path) {
         return false;
     }
 
-    // Parse kallsyms
-    auto kernel_symbols = parse_kallsyms();
-    if (kernel_symbols.empty()) {
-        KLOGE("Cannot parse kallsyms");
+    if (!patch_undefined_symbols(buffer)) {
         return false;
     }
 
-    // Find symbol table section
-    auto* shdr_base = reinterpret_cast<Elf64_Shdr*>(buffer.data() + ehdr->e_shoff);
-
-    Elf64_Shdr* symtab = nullptr;
-    Elf64_Shdr* strtab = nullptr;
-
-    for (int i = 0; i < ehdr->e_shnum; i++) {
-        auto* shdr = &shdr_base[i];
-        if (shdr->sh_type == SHT_SYMTAB) {
-            symtab = shdr;
-            // String table is linked in sh_link
-            strtab = &shdr_base[shdr->sh_link];
-            break;
-        }
-    }
-
-    if (!symtab || !strtab) {
-        KLOGE("Cannot find symbol table");
-        return false;
-    }
-
-    // Get pointers to symbol and string tables
-    auto* sym_base = reinterpret_cast<Elf64_Sym*>(buffer.data() + symtab->sh_offset);
-    auto* str_base = reinterpret_cast<char*>(buffer.data() + strtab->sh_offset);
-
-    const size_t sym_count = symtab->sh_size / sizeof(Elf64_Sym);
-
-    // Resolve undefined symbols
-    for (size_t i = 1; i < sym_count; i++) {
-        auto* sym = &sym_base[i];
-
-        // Only process undefined symbols
-        if (sym->st_shndx != SHN_UNDEF) {
-            continue;
-        }
-
-        // Get symbol name
-        const char* name = &str_base[sym->st_name];
-        if (!name || !*name) {
-            continue;
-        }
-
-        // Look up in kernel symbols
-        auto it = kernel_symbols.find(name);
-        if (it == kernel_symbols.end()) {
-            KLOGW("Cannot find symbol: %s", name);
-            continue;
-        }
-
-        // Patch the symbol
-        sym->st_shndx = SHN_ABS;
-        sym->st_value = it->second;
-    }
-
     std::string param_values;
     {
         const std::ifstream config("/ksu_config", std::ios::binary);
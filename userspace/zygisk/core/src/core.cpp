@@ -6,7 +6,10 @@
  */
 
 #include "hook.hpp"
+#include "inline_hook.hpp"
 #include "log.hpp"
+#include "patch_text.hpp"
+#include "phase.hpp"
 #include "solist.hpp"
 #include "yukilinker.hpp"
 #include "zygisk.hpp"
@@ -33,6 +36,7 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <deque>
 #include <vector>
 
@@ -48,6 +52,12 @@ namespace {
 #ifndef MFD_CLOEXEC
 #define MFD_CLOEXEC 0x0001U
 #endif // #ifndef MFD_CLOEXEC
+#ifndef PR_SET_VMA
+#define PR_SET_VMA 0x53564d41
+#endif // #ifndef PR_SET_VMA
+#ifndef PR_SET_VMA_ANON_NAME
+#define PR_SET_VMA_ANON_NAME 0
+#endif // #ifndef PR_SET_VMA_ANON_NAME
 
 /* Module-facing API table. */
 struct CoreApiTable {
@@ -76,6 +86,7 @@ int zd_module_dir(int id);
 int zd_connect_companion(int id);
 uint32_t zd_get_flags(int uid);
 int g_app_uid = -1; // uid of the process currently being specialized
+bool g_app_denylisted = false; // no timing report from denylisted processes
 bool g_module_policy_armed = false;
 
 void api_hook_jni_native_methods(JNIEnv *env, const char *cls,
@@ -126,7 +137,10 @@ bool api_plt_hook_commit() { return zygisk_plt_hook_commit(); }
 bool api_exempt_fd(int fd) { return zygisk_exempt_fd(fd); }
 
 int api_connect_companion(void * /*impl*/) {
-  return g_cur != nullptr ? zd_connect_companion(g_cur->id) : -1;
+  int fd = g_cur != nullptr ? zd_connect_companion(g_cur->id) : -1;
+  if (fd >= 0)
+    zygisk_track_module_fd(fd);
+  return fd;
 }
 
 void api_set_option(void * /*impl*/, Option opt) {
@@ -137,8 +151,10 @@ void api_set_option(void * /*impl*/, Option opt) {
 int api_get_module_dir(void * /*impl*/) {
   // Fresh fd; fork sanitization closes it unless exempted.
   int fd = g_cur != nullptr ? zd_module_dir(g_cur->id) : -1;
-  if (fd >= 0)
+  if (fd >= 0) {
     g_module_policy_armed = true;
+    zygisk_track_module_fd(fd);
+  }
   return fd;
 }
 
@@ -194,6 +210,10 @@ enum class ZdRequest : uint8_t {
   PatchText = 11,
   ReportZygote = 12,
   RestoreLoadPolicy = 17,
+  GetPreloadModules = 19,
+  PatchTextBatch = 20,
+  ReportTiming = 21,
+  SetSoinfoLayout = 22,
 };
 #if defined(__LP64__)
 constexpr char kZygiskdSocket[] = "zygiskd64";
@@ -213,6 +233,18 @@ bool read_all(int fd, void *buf, size_t n) {
   return true;
 }
 
+bool write_all(int fd, const void *buf, size_t n) {
+  const auto *p = static_cast<const uint8_t *>(buf);
+  while (n > 0) {
+    ssize_t w = write(fd, p, n);
+    if (w <= 0)
+      return false;
+    p += w;
+    n -= static_cast<size_t>(w);
+  }
+  return true;
+}
+
 int recv_fd(int sock) {
   char data = 0;
   char cbuf[CMSG_SPACE(sizeof(int))] = {};
@@ -274,6 +306,7 @@ int zd_connect_companion(int id) {
 }
 
 uint32_t zd_get_flags(int uid) {
+  yuki::phase::Scope timed(yuki::phase::kGetFlags);
   int sock = connect_zygiskd();
   if (sock < 0)
     return 0;
@@ -293,7 +326,10 @@ uint32_t zd_get_flags(int uid) {
 using module_entry_fn = void (*)(api_table *, JNIEnv *);
 constexpr char kExecMemfdName[] = "data-code-cache";
 
-/* Copy a daemon-staged image into a zygote-owned executable memfd. */
+/*
+ * Copy a daemon-staged image into a zygote-owned executable memfd. Only the
+ * system linker fallback needs this; yukilinker reads the daemon fd directly.
+ */
 int make_app_memfd(int src_fd) {
   struct stat st{};
   if (fstat(src_fd, &st) != 0 || st.st_size <= 0)
@@ -349,6 +385,34 @@ void zd_report_zygote() {
   close(s);
 }
 
+/* Adopt soinfo offsets an earlier zygote probed for this linker. */
+void offer_config_soinfo_layout() {
+  if (g_yz_config.linker_id == 0)
+    return;
+  yuki::solist::offer_soinfo_layout(
+      {g_yz_config.linker_id, g_yz_config.soinfo_size_off,
+       g_yz_config.soinfo_next_off, g_yz_config.soinfo_ctor_off});
+}
+
+/* Hand freshly probed offsets to zygiskd for later zygotes and processes. */
+void zd_share_soinfo_layout() {
+  yuki::solist::SoinfoLayout l{};
+  if (!yuki::solist::probed_soinfo_layout(&l))
+    return;
+  yz_config cfg{};
+  cfg.soinfo_size_off = l.size_off;
+  cfg.soinfo_next_off = l.next_off;
+  cfg.soinfo_ctor_off = l.ctor_off;
+  cfg.linker_id = l.linker_id;
+  int s = connect_zygiskd();
+  if (s < 0)
+    return;
+  uint8_t req = static_cast<uint8_t>(ZdRequest::SetSoinfoLayout);
+  if (write_all(s, &req, 1))
+    (void)write_all(s, &cfg, sizeof(cfg));
+  close(s);
+}
+
 void zd_restore_load_policy() {
   int s = connect_zygiskd();
   if (s < 0)
@@ -397,6 +461,8 @@ extern "C" void yz_klog(const char *fmt, ...) {
 extern "C" {
 __attribute__((visibility("hidden"))) void *
 yuki_core_dlopen_memfd(int memfd, const char *vma_name);
+__attribute__((visibility("hidden"))) void *
+yuki_core_dlopen_anon(int fd, const char *vma_name);
 __attribute__((visibility("hidden"))) void *yuki_core_dlsym(void *handle,
                                                             const char *name);
 __attribute__((visibility("hidden"))) void yuki_core_dlclose(void *handle);
@@ -405,12 +471,170 @@ using yuki_dlopen_fn = void *(*)(int, const char *);
 using yuki_dlsym_fn = void *(*)(void *, const char *);
 using yuki_dlclose_fn = void (*)(void *);
 yuki_dlopen_fn g_yuki_dlopen = nullptr;
+yuki_dlopen_fn g_yuki_dlopen_anon = nullptr;
 yuki_dlsym_fn g_yuki_dlsym = nullptr;
 yuki_dlclose_fn g_yuki_dlclose = nullptr;
 /* libzygisk mapping range from yukilinker. */
 uintptr_t g_self_base = 0;
 size_t g_self_size = 0;
 
+/*
+ * Fetch module i from zygiskd and load it; system linker unless yuki_only.
+ * A preload (yuki_only) leaves the constructors to yukilinker::initialize().
+ */
+void *load_module_image(uint32_t i, bool yuki_only, module_entry_fn *entry,
+                        bool *yuki_loaded) {
+  *entry = nullptr;
+  *yuki_loaded = false;
+  int lib_fd = zd_request_fd(ZdRequest::GetModuleFd, i);
+  if (lib_fd < 0) {
+    LOGE("no fd for module %u", i);
+    return nullptr;
+  }
+  void *handle = nullptr;
+  // yukilinker copies PT_LOAD payloads from the sealed daemon image into
+  // private anonymous pages, so no executable mapping of the daemon's tmpfs
+  // inode is created and no staging memfd is needed.
+  if (g_yuki_dlopen_anon != nullptr && g_yuki_dlsym != nullptr &&
+      g_yuki_dlclose != nullptr) {
+    handle = yuki_only ? yukilinker::dlopen_memfd(lib_fd, kExecMemfdName,
+                                                  false, /*defer_init=*/true)
+                       : g_yuki_dlopen_anon(lib_fd, kExecMemfdName);
+    if (handle != nullptr) {
+      *yuki_loaded = true;
+      auto *so = static_cast<yukilinker::SoHandle *>(handle);
+      prctl(PR_SET_VMA, PR_SET_VMA_ANON_NAME, so->map_start, so->map_size,
+            kExecMemfdName);
+      *entry = reinterpret_cast<module_entry_fn>(
+          g_yuki_dlsym(handle, "zygisk_module_entry"));
+    }
+  }
+  if (handle == nullptr && !yuki_only) {
+    // The system linker maps the fd itself; give it a zygote-owned copy so
+    // executable mappings use the local tmpfs label.
+    int mfd = make_app_memfd(lib_fd);
+    if (mfd >= 0) {
+      android_dlextinfo ext{};
+      ext.flags = ANDROID_DLEXT_USE_LIBRARY_FD | ANDROID_DLEXT_FORCE_LOAD;
+      ext.library_fd = mfd;
+      handle = android_dlopen_ext("libzygiskmodule.so", RTLD_NOW | RTLD_LOCAL,
+                                  &ext);
+      if (handle != nullptr) {
+        LOGI("module %u using system linker fallback", i);
+        *entry = reinterpret_cast<module_entry_fn>(
+            dlsym(handle, "zygisk_module_entry"));
+      }
+      close(mfd);
+    }
+  }
+  close(lib_fd);
+  return handle;
+}
+
+/* Mirrors zygiskd::PreloadModuleInfo. */
+struct ZdPreloadInfo {
+  uint32_t index;
+  char name[64];
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t size;
+  int64_t mtime_ns;
+};
+
+bool zd_get_preload_list(std::vector<ZdPreloadInfo> *out) {
+  int s = connect_zygiskd();
+  if (s < 0)
+    return false;
+  auto req = static_cast<uint8_t>(ZdRequest::GetPreloadModules);
+  uint32_t n = 0;
+  bool ok = write(s, &req, 1) == 1 && read_all(s, &n, sizeof(n)) && n <= 256;
+  if (ok) {
+    out->resize(n);
+    ok = n == 0 || read_all(s, out->data(), n * sizeof(ZdPreloadInfo));
+  }
+  close(s);
+  return ok;
+}
+
+/*
+ * Fork-safe modules relocated once in zygote; children inherit them COW.
+ * Their constructors only run in the child that claims them, so nothing a
+ * module opens can leak into zygote and trip its fd allowlist on fork.
+ */
+struct PreloadedModule {
+  ZdPreloadInfo info;
+  void *handle;
+  module_entry_fn entry;
+};
+std::vector<PreloadedModule> g_preloaded;
+
+/*
+ * Unmap inherited images nobody claimed. They were never entered in this
+ * process, so their finalizers must not run here either (denylisted apps
+ * in particular).
+ */
+void drop_preloaded_modules() {
+  for (auto &p : g_preloaded)
+    yukilinker::discard(static_cast<yukilinker::SoHandle *>(p.handle));
+  g_preloaded.clear();
+}
+
+bool same_preload_image(const ZdPreloadInfo &a, const ZdPreloadInfo &b) {
+  return a.index == b.index && strncmp(a.name, b.name, sizeof(a.name)) == 0 &&
+         a.dev == b.dev && a.ino == b.ino && a.size == b.size &&
+         a.mtime_ns == b.mtime_ns;
+}
+
+/* Claim an inherited image if zygiskd still lists the same module file. */
+void *take_preloaded(uint32_t i, const std::vector<ZdPreloadInfo> &now,
+                     module_entry_fn *entry) {
+  for (auto it = g_preloaded.begin(); it != g_preloaded.end(); ++it) {
+    if (it->info.index != i)
+      continue;
+    for (const auto &n : now) {
+      if (!same_preload_image(n, it->info))
+        continue;
+      void *handle = it->handle;
+      *entry = it->entry;
+      g_preloaded.erase(it);
+      yukilinker::initialize(static_cast<yukilinker::SoHandle *>(handle));
+      return handle;
+    }
+    return nullptr;
+  }
+  return nullptr;
+}
+
+long since_us(const timespec &t0) {
+  timespec t1;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  return (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_nsec - t0.tv_nsec) / 1000;
+}
+
+void preload_modules_impl() {
+  if (g_yuki_dlopen_anon == nullptr || !g_preloaded.empty())
+    return;
+  std::vector<ZdPreloadInfo> list;
+  if (!zd_get_preload_list(&list) || list.empty())
+    return;
+  timespec t0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (const auto &info : list) {
+    module_entry_fn entry = nullptr;
+    bool yuki_loaded = false;
+    void *handle = load_module_image(info.index, true, &entry, &yuki_loaded);
+    if (handle == nullptr)
+      continue;
+    if (entry == nullptr) {
+      yukilinker::discard(static_cast<yukilinker::SoHandle *>(handle));
+      continue;
+    }
+    g_preloaded.push_back({info, handle, entry});
+  }
+  LOGI("preloaded %zu/%zu fork-safe module(s) in zygote, %ld us",
+       g_preloaded.size(), list.size(), since_us(t0));
+}
+
 void load_modules_impl(JNIEnv *env) {
   if (!g_modules.empty())
     return;         // already loaded in this process (called per-specialize)
@@ -429,53 +653,31 @@ void load_modules_impl(JNIEnv *env) {
   close(sock);
   LOGI("zygiskd reports %u module(s)", count);
 
-  for (uint32_t i = 0; i < count; ++i) {
-    int s = connect_zygiskd();
-    if (s < 0)
-      continue;
-    req = static_cast<uint8_t>(ZdRequest::GetModuleFd);
-    if (write(s, &req, 1) != 1 || write(s, &i, sizeof(i)) != sizeof(i)) {
-      close(s);
-      continue;
-    }
-    int lib_fd = recv_fd(s);
-    close(s);
-    if (lib_fd < 0) {
-      LOGE("no fd for module %u", i);
-      continue;
-    }
+  // Inherited images are only trusted if the module list is unchanged.
+  std::vector<ZdPreloadInfo> preload_now;
+  if (!g_preloaded.empty() && !zd_get_preload_list(&preload_now))
+    preload_now.clear();
 
-    void *handle = nullptr;
+  long total_load_us = 0;
+  size_t inherited = 0;
+  zygisk_plt_hook_begin_phase();
+  for (uint32_t i = 0; i < count; ++i) {
+    timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
     module_entry_fn entry = nullptr;
-    bool yuki_loaded = false;
-    // zygiskd sends a sealed anonymous image. Copy it once more into a
-    // zygote-owned memfd so executable mappings use the local tmpfs label.
-    int mfd = make_app_memfd(lib_fd);
-    close(lib_fd);
-    if (mfd >= 0) {
-      if (g_yuki_dlopen != nullptr && g_yuki_dlsym != nullptr &&
-          g_yuki_dlclose != nullptr) {
-        handle = g_yuki_dlopen(mfd, kExecMemfdName);
-        if (handle != nullptr) {
-          yuki_loaded = true;
-          entry = reinterpret_cast<module_entry_fn>(
-              g_yuki_dlsym(handle, "zygisk_module_entry"));
-        }
-      }
-      if (handle == nullptr) {
-        android_dlextinfo ext{};
-        ext.flags = ANDROID_DLEXT_USE_LIBRARY_FD | ANDROID_DLEXT_FORCE_LOAD;
-        ext.library_fd = mfd;
-        handle = android_dlopen_ext("libzygiskmodule.so", RTLD_NOW | RTLD_LOCAL,
-                                    &ext);
-        if (handle != nullptr) {
-          LOGI("module %u using system linker fallback", i);
-          entry = reinterpret_cast<module_entry_fn>(
-              dlsym(handle, "zygisk_module_entry"));
-        }
-      }
-      close(mfd);
+    bool yuki_loaded = true;
+    yuki::phase::ModuleNs *mt = yuki::phase::module(i);
+    void *handle = nullptr;
+    {
+      yuki::phase::Scope timed(yuki::phase::kModuleLoad,
+                               mt != nullptr ? &mt->load : nullptr);
+      handle = take_preloaded(i, preload_now, &entry);
+      if (handle != nullptr)
+        ++inherited;
+      else
+        handle = load_module_image(i, false, &entry, &yuki_loaded);
     }
+    total_load_us += since_us(t0);
     if (handle == nullptr) {
       LOGE("dlopen module %u failed", i);
       continue;
@@ -496,13 +698,20 @@ void load_modules_impl(JNIEnv *env) {
     m.api.registerModule = RegisterModuleImpl;
     g_loading = &m;
     g_loading_id = static_cast<int>(i);
-    entry(reinterpret_cast<api_table *>(&m.api), env);
+    {
+      yuki::phase::Scope timed(yuki::phase::kOnLoad,
+                               mt != nullptr ? &mt->onload : nullptr);
+      entry(reinterpret_cast<api_table *>(&m.api), env);
+    }
     if (m.version == 0)
       g_modules.pop_back();
   }
+  zygisk_plt_hook_end_phase("onLoad");
+  drop_preloaded_modules(); // stale after a module rescan
   g_loading = nullptr;
   g_cur = nullptr;
-  LOGI("loaded %zu module(s)", g_modules.size());
+  LOGI("loaded %zu module(s) (%zu inherited from zygote), image load %ld us",
+       g_modules.size(), inherited, total_load_us);
 }
 
 /* zygisk API v1/v2 AppSpecializeArgs layout. */
@@ -556,22 +765,95 @@ void unload_requested_modules() {
   }
 }
 
+/* Per-module counter for the current phase record, or nullptr. */
+uint64_t *module_ns(const Module &m, uint64_t yuki::phase::ModuleNs::*field) {
+  yuki::phase::ModuleNs *mt = yuki::phase::module(static_cast<uint32_t>(m.id));
+  return mt != nullptr ? &(mt->*field) : nullptr;
+}
+
+/* Mirrors zygiskd::SpecModuleTiming / SpecArena / SpecTiming. */
+struct ZdSpecModuleTiming {
+  uint32_t index;
+  uint32_t load_us;
+  uint32_t onload_us;
+  uint32_t pre_us;
+  uint32_t post_us;
+};
+struct ZdSpecArena {
+  uint32_t pages;
+  uint32_t live;
+  uint32_t free;
+  uint32_t wasted;
+};
+struct ZdSpecTiming {
+  uint32_t uid;
+  uint32_t phase_mask;
+  uint32_t phase_us[yuki::phase::kCount];
+  uint32_t module_count;
+  ZdSpecModuleTiming modules[yuki::phase::kModuleMax];
+  ZdSpecArena arena;
+};
+
+uint32_t clamp_u32(size_t v) {
+  return v > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(v);
+}
+
+uint32_t ns_to_us(uint64_t ns) {
+  uint64_t us = ns / 1000;
+  return us > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(us);
+}
+
+/* Send this specialization's phase record to zygiskd, once. */
+void zd_report_timing() {
+  yuki::phase::Record &r = yuki::phase::g_record;
+  if (r.mask == 0 || g_app_denylisted)
+    return;
+  ZdSpecTiming t{};
+  t.uid = static_cast<uint32_t>(g_app_uid);
+  t.phase_mask = r.mask;
+  for (uint32_t i = 0; i < yuki::phase::kCount; ++i)
+    t.phase_us[i] = ns_to_us(r.ns[i]);
+  t.module_count = r.module_count;
+  for (uint32_t i = 0; i < r.module_count; ++i) {
+    const yuki::phase::ModuleNs &m = r.modules[i];
+    t.modules[i] = {m.index, ns_to_us(m.load), ns_to_us(m.onload),
+                    ns_to_us(m.pre), ns_to_us(m.post)};
+  }
+  yukilinker::ArenaStats arena{};
+  yukilinker::arena_stats(&arena);
+  t.arena = {clamp_u32(arena.pages), clamp_u32(arena.live_bytes),
+             clamp_u32(arena.free_bytes), clamp_u32(arena.wasted_bytes)};
+  r.mask = 0; // one report per specialization
+  int s = connect_zygiskd();
+  if (s < 0)
+    return;
+  uint8_t req = static_cast<uint8_t>(ZdRequest::ReportTiming);
+  if (write_all(s, &req, 1))
+    (void)write_all(s, &t, sizeof(t));
+  close(s);
+}
+
 void run_app_pre_impl(zygisk::AppSpecializeArgs *args) {
   g_app_uid = args->uid;
   AppSpecializeArgs_v1 v1args(args);
+  zygisk_plt_hook_begin_phase();
   for (auto &m : g_modules)
     if (m.abi != nullptr && m.abi->preAppSpecialize != nullptr) {
       g_cur = &m;
+      yuki::phase::Scope timed(yuki::phase::kPreSpecialize,
+                               module_ns(m, &yuki::phase::ModuleNs::pre));
       m.abi->preAppSpecialize(m.abi->impl,
                               reinterpret_cast<zygisk::AppSpecializeArgs *>(
                                   app_args_for(m, args, &v1args)));
     }
   g_cur = nullptr;
+  zygisk_plt_hook_end_phase("preAppSpecialize");
   zd_restore_module_load_policy();
 }
 
 /* Hide injected linker entries. */
 void hide_injection() {
+  yuki::phase::Scope timed(yuki::phase::kHideSolist);
   yuki::solist::hide_from_solist("libzygisk");
   yuki::solist::hide_from_solist("libyukilinker"); // split-out loader .so
   yuki::solist::drop_module_from_solist(kExecMemfdName, false);
@@ -594,23 +876,32 @@ static void yz_revert_self_mounts() {
 void run_app_post_impl(const zygisk::AppSpecializeArgs *args) {
   auto *mut = const_cast<zygisk::AppSpecializeArgs *>(args);
   AppSpecializeArgs_v1 v1args(mut);
+  zygisk_plt_hook_begin_phase();
   for (auto &m : g_modules)
     if (m.abi != nullptr && m.abi->postAppSpecialize != nullptr) {
       g_cur = &m;
+      yuki::phase::Scope timed(yuki::phase::kPostSpecialize,
+                               module_ns(m, &yuki::phase::ModuleNs::post));
       m.abi->postAppSpecialize(
           m.abi->impl, reinterpret_cast<const zygisk::AppSpecializeArgs *>(
                            app_args_for(m, mut, &v1args)));
     }
   g_cur = nullptr;
+  zygisk_plt_hook_end_phase("postAppSpecialize");
+  zd_report_timing(); // before any module image is dlclosed
   unload_requested_modules();
   hide_injection();
-  yuki::solist::spoof_virtual_maps("/dev/zero (deleted)", false);
+  {
+    yuki::phase::Scope timed(yuki::phase::kSpoofMaps);
+    yuki::solist::spoof_virtual_maps("/dev/zero (deleted)", false);
+  }
   yz_drop_runtime_header_pages();
 }
 
 void run_server_pre_impl(zygisk::ServerSpecializeArgs *args) {
   g_app_uid = args->uid;
   LOGI("run_server_pre: uid=%d, %zu module(s)", args->uid, g_modules.size());
+  zygisk_plt_hook_begin_phase();
   for (auto &m : g_modules) {
     LOGI("  module %d: preServer=%p postServer=%p", m.id,
          m.abi ? reinterpret_cast<void *>(m.abi->preServerSpecialize) : nullptr,
@@ -618,22 +909,30 @@ void run_server_pre_impl(zygisk::ServerSpecializeArgs *args) {
                : nullptr);
     if (m.abi != nullptr && m.abi->preServerSpecialize != nullptr) {
       g_cur = &m;
+      yuki::phase::Scope timed(yuki::phase::kPreSpecialize,
+                               module_ns(m, &yuki::phase::ModuleNs::pre));
       m.abi->preServerSpecialize(m.abi->impl, args);
     }
   }
   g_cur = nullptr;
+  zygisk_plt_hook_end_phase("preServerSpecialize");
   zd_restore_module_load_policy();
 }
 
 void run_server_post_impl(const zygisk::ServerSpecializeArgs *args) {
   LOGI("run_server_post: %zu module(s)", g_modules.size());
+  zygisk_plt_hook_begin_phase();
   for (auto &m : g_modules)
     if (m.abi != nullptr && m.abi->postServerSpecialize != nullptr) {
       LOGI("  module %d postServerSpecialize", m.id);
       g_cur = &m;
+      yuki::phase::Scope timed(yuki::phase::kPostSpecialize,
+                               module_ns(m, &yuki::phase::ModuleNs::post));
       m.abi->postServerSpecialize(m.abi->impl, args);
     }
   g_cur = nullptr;
+  zygisk_plt_hook_end_phase("postServerSpecialize");
+  zd_report_timing(); // before any module image is dlclosed
   unload_requested_modules();
   hide_injection();
 }
@@ -641,25 +940,21 @@ void run_server_post_impl(const zygisk::ServerSpecializeArgs *args) {
 } // namespace
 
 /* Patch our own text through zygiskd/kernel. */
-extern "C" bool yz_patch_text(uintptr_t addr, const void *bytes,
-                              unsigned int len) {
-  if (bytes == nullptr || len == 0 || len > 64)
-    return false;
+extern "C" unsigned int yz_patch_text_v(const yz_patch_vec *v,
+                                        unsigned int n) {
   int s = connect_zygiskd();
   if (s < 0)
-    return false;
-  uint8_t req = static_cast<uint8_t>(ZdRequest::PatchText);
-  uint64_t a64 = addr;
-  uint32_t l32 = len;
-  uint8_t ack = 0;
-  bool ok = write(s, &req, 1) == 1 &&
-            write(s, &a64, sizeof(a64)) == static_cast<ssize_t>(sizeof(a64)) &&
-            write(s, &l32, sizeof(l32)) == static_cast<ssize_t>(sizeof(l32)) &&
-            write(s, bytes, len) == static_cast<ssize_t>(len);
-  if (ok)
-    ok = read_all(s, &ack, 1) && ack != 0;
+    return 0;
+  unsigned int applied = yuki::patch::send_batch(
+      s, static_cast<uint8_t>(ZdRequest::PatchTextBatch), v, n);
   close(s);
-  return ok;
+  return applied;
+}
+
+extern "C" bool yz_patch_text(uintptr_t addr, const void *bytes,
+                              unsigned int len) {
+  yz_patch_vec v{addr, bytes, len};
+  return yz_patch_text_v(&v, 1) == 1;
 }
 
 extern "C" {
@@ -675,12 +970,15 @@ static void core_start(const char *self_path) {
         (*p)();
   }
   g_yuki_dlopen = yuki_core_dlopen_memfd;
+  g_yuki_dlopen_anon = yuki_core_dlopen_anon;
   g_yuki_dlsym = yuki_core_dlsym;
   g_yuki_dlclose = yuki_core_dlclose;
   zd_report_zygote();
   zd_restore_load_policy();
   LOGI("core start, self=%s", self_path ? self_path : "(null)");
   zygisk_hook_bootstrap(self_path);
+  if (!yuki::solist::prepare_linker_view())
+    LOGE("linker64 symbol view unavailable; solist hiding disabled");
 }
 
 /* Address inside the first-stage loader mapping. */
@@ -985,11 +1283,13 @@ zygisk_core_entry_direct(int /*core_fd*/) {
 extern "C" [[gnu::visibility("default")]] void zygisk_finalize_loader(int,
                                                                       int) {
   zd_load_config();
+  offer_config_soinfo_layout();
   LOGI("finalize_loader: finalizing loader at base=%p munmap=%d",
        reinterpret_cast<void *>(g_loader_base), g_loader_unmap_safe);
   int n =
       yuki::solist::drop_lib_containing(g_loader_base, !g_loader_unmap_safe);
   LOGI("finalize_loader: unloaded %d soinfo(s)", n);
+  zd_share_soinfo_layout();
 }
 
 /* 0=inject, 1=inject+umount, 2=skip+umount. */
@@ -998,7 +1298,8 @@ int zygisk_inject_decision(int uid) {
   zd_load_config();
   uint32_t flags = zd_get_flags(uid);
   int dec = 0;
-  if (flags & zygisk::PROCESS_ON_DENYLIST) {
+  g_app_denylisted = (flags & zygisk::PROCESS_ON_DENYLIST) != 0;
+  if (g_app_denylisted) {
     if (g_yz_config.denylist_mode == 1)
       dec = 2;
     else if (g_yz_config.denylist_mode == 2)
@@ -1068,7 +1369,9 @@ static inline void yz_finalize_self_dso() {
   __cxa_finalize(static_cast<void *>(&__dso_handle));
 }
 
+/* Only denylisted processes get here, and those report no timing. */
 void zygisk_self_destruct(JNIEnv *env, bool isolated) {
+  drop_preloaded_modules(); // inherited fork-safe images, never entered
   bool can_unmap = zygisk_specialize_fully_inline_hooked();
   zygisk_self_unhook(env);
   yz_drop_runtime_header_pages();
@@ -1097,6 +1400,7 @@ void zygisk_self_destruct(JNIEnv *env, bool isolated) {
 }
 
 void zygisk_load_modules(JNIEnv *env) { load_modules_impl(env); }
+void zygisk_preload_modules() { preload_modules_impl(); }
 void zygisk_run_app_pre(zygisk::AppSpecializeArgs *args) {
   run_app_pre_impl(args);
 }
@@ -9,20 +9,35 @@
 
 #include <jni.h>
 
+#include <algorithm>
 #include <array>
+#include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <deque>
 #include <dirent.h>
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/sysmacros.h>
+#include <string>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 
 #include "art_method.hpp"
 #include "hook.hpp"
 #include "inline_hook.hpp"
 #include "log.hpp"
+#include "phase.hpp"
+
+#ifndef __NR_close_range
+#define __NR_close_range 436
+#endif // #ifndef __NR_close_range
 
 namespace {
 
@@ -64,8 +79,10 @@ struct ZygiskContext {
   JNIEnv *env = nullptr;
   pid_t pid = -1; // <0 not forked; ==0 child; >0 zygote (parent)
   jintArray *fds_to_ignore = nullptr; // app fork only -- the exempt channel
-  std::vector<bool> allowed_fds;
+  std::vector<int> allowed_fds; // sorted keep list
   std::vector<int> exempted_fds;
+  long fd_ns = 0;    // snapshot + sanitize time
+  int fd_ranges = 0; // close_range calls, -1 = readdir fallback
 };
 
 ZygiskContext *g_ctx = nullptr;
@@ -99,14 +116,53 @@ int new_fork() {
              : (g_orig_fork != nullptr ? g_orig_fork() : fork());
 }
 
-size_t fd_table_size() {
-  long n = sysconf(_SC_OPEN_MAX);
-  return n > 0 ? static_cast<size_t>(n) : 1024;
+/* Decimal /proc/self/fd entry name; -1 for "." and "..". */
+int parse_fd_name(const char *name) {
+  if (*name == '\0')
+    return -1;
+  int fd = 0;
+  for (; *name != '\0'; ++name) {
+    if (*name < '0' || *name > '9')
+      return -1;
+    fd = fd * 10 + (*name - '0');
+  }
+  return fd;
+}
+
+/* One raw getdents64 pass over /proc/self/fd, no DIR allocation. */
+template <class F> void for_each_open_fd(F &&fn) {
+  int dfd = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dfd < 0)
+    return;
+  alignas(dirent64) char buf[4096];
+  for (;;) {
+    long n = syscall(SYS_getdents64, dfd, buf, sizeof(buf));
+    if (n <= 0)
+      break;
+    for (long off = 0; off < n;) {
+      auto *e = reinterpret_cast<dirent64 *>(buf + off);
+      off += e->d_reclen;
+      int fd = parse_fd_name(e->d_name);
+      if (fd >= 0 && fd != dfd)
+        fn(fd);
+    }
+  }
+  close(dfd);
 }
 
 void mark_allowed(ZygiskContext *ctx, int fd) {
-  if (fd >= 0 && static_cast<size_t>(fd) < ctx->allowed_fds.size())
-    ctx->allowed_fds[fd] = true;
+  if (fd < 0)
+    return;
+  auto &v = ctx->allowed_fds;
+  auto it = std::lower_bound(v.begin(), v.end(), fd);
+  if (it == v.end() || *it != fd)
+    v.insert(it, fd);
+}
+
+long elapsed_ns(const timespec &t0) {
+  timespec t1;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  return (t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec);
 }
 
 /* Real fork; child snapshots native fds. */
@@ -114,42 +170,80 @@ void ctx_fork_pre(ZygiskContext *ctx) {
   ctx->pid = g_orig_fork != nullptr ? g_orig_fork() : fork();
   if (ctx->pid != 0)
     return; // zygote
-  ctx->allowed_fds.assign(fd_table_size(), false);
-  if (DIR *d = opendir("/proc/self/fd")) {
-    int dfd = dirfd(d);
-    while (dirent *e = readdir(d))
-      mark_allowed(ctx, atoi(e->d_name));
-    if (dfd >= 0 && static_cast<size_t>(dfd) < ctx->allowed_fds.size())
-      ctx->allowed_fds[dfd] = false;
-    closedir(d);
-  }
+  yuki::phase::reset();
+  timespec t0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  ctx->allowed_fds.clear();
+  for_each_open_fd([ctx](int fd) { ctx->allowed_fds.push_back(fd); });
+  std::sort(ctx->allowed_fds.begin(), ctx->allowed_fds.end());
+  ctx->fd_ns = elapsed_ns(t0);
+  yuki::phase::add(yuki::phase::kForkPre, static_cast<uint64_t>(ctx->fd_ns));
 }
 
-/* Drop inherited module fds. */
+/* Module-owned fds, recorded when handed out; inherited by child zygotes. */
+struct ModuleFd {
+  int fd;
+  dev_t dev;
+  ino_t ino;
+};
+std::vector<ModuleFd> g_module_fds;
+
+/*
+ * Drop inherited module fds; dev/ino guards against reused numbers. Every fd
+ * the core hands a module (module dir, companion socket) is registered where
+ * it is created, so no /proc/self/fd scan is needed.
+ */
 int close_inherited_module_fds() {
-  DIR *d = opendir("/proc/self/fd");
-  if (d == nullptr)
-    return 0;
-  int dfd = dirfd(d);
   int closed = 0;
-  char target[256];
-  for (dirent *e; (e = readdir(d)) != nullptr;) {
-    int fd = atoi(e->d_name);
-    if (fd < 0 || fd == dfd)
+  for (const ModuleFd &m : g_module_fds) {
+    struct stat st;
+    if (fstat(m.fd, &st) != 0 || st.st_dev != m.dev || st.st_ino != m.ino)
       continue;
-    ssize_t n = readlinkat(dfd, e->d_name, target, sizeof(target) - 1);
-    if (n <= 0)
-      continue;
-    target[n] = '\0';
-    if (strstr(target, "/data/adb/modules") != nullptr) {
-      close(fd);
-      ++closed;
-    }
+    close(m.fd);
+    ++closed;
   }
-  closedir(d);
+  g_module_fds.clear();
   return closed;
 }
 
+bool g_no_close_range = false;
+
+/* Close [lo, hi]; false once the kernel lacks close_range. */
+bool close_fd_range(unsigned lo, unsigned hi) {
+  if (g_no_close_range)
+    return false;
+  if (syscall(__NR_close_range, lo, hi, 0) == 0)
+    return true;
+  if (errno == ENOSYS || errno == EINVAL)
+    g_no_close_range = true;
+  return false;
+}
+
+/*
+ * Close every fd outside the sorted keep list. Returns the number of
+ * close_range calls, or -1 if the enumerate-and-close fallback ran.
+ */
+int close_disallowed_fds(const std::vector<int> &keep) {
+  int ranges = 0;
+  unsigned lo = 0;
+  bool ok = true;
+  for (int fd : keep) {
+    if (static_cast<unsigned>(fd) > lo) {
+      if (!(ok = close_fd_range(lo, static_cast<unsigned>(fd) - 1)))
+        break;
+      ++ranges;
+    }
+    lo = static_cast<unsigned>(fd) + 1;
+  }
+  if (ok && close_fd_range(lo, ~0U))
+    return ranges + 1;
+  for_each_open_fd([&keep](int fd) {
+    if (!std::binary_search(keep.begin(), keep.end(), fd))
+      close(fd);
+  });
+  return -1;
+}
+
 /* Apply exemptFd and close non-native fds in the child. */
 void ctx_sanitize_fds(ZygiskContext *ctx) {
   if (ctx->pid != 0)
@@ -184,18 +278,21 @@ void ctx_sanitize_fds(ZygiskContext *ctx) {
     }
   }
 
-  if (DIR *d = opendir("/proc/self/fd")) {
-    int dfd = dirfd(d);
-    while (dirent *e = readdir(d)) {
-      int fd = atoi(e->d_name);
-      if (fd < 0 || fd == dfd)
-        continue;
-      if (static_cast<size_t>(fd) >= ctx->allowed_fds.size() ||
-          !ctx->allowed_fds[fd])
-        close(fd);
-    }
-    closedir(d);
-  }
+  // Real close, not CLOEXEC: the zygote fd table check runs before exec.
+  timespec t0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  ctx->fd_ranges = close_disallowed_fds(ctx->allowed_fds);
+  long ns = elapsed_ns(t0);
+  ctx->fd_ns += ns;
+  yuki::phase::add(yuki::phase::kFdSanitize, static_cast<uint64_t>(ns));
+}
+
+/* Logged after specialize so logd's socket never trips the fd check. */
+void ctx_report_fd_stats(const ZygiskContext *ctx) {
+  if (ctx->pid != 0 || ctx->fd_ns == 0)
+    return;
+  ZLOGD("fd sanitize: kept %zu, %d close_range call(s), %ld us",
+        ctx->allowed_fds.size(), ctx->fd_ranges, ctx->fd_ns / 1000);
 }
 
 /* Replacement zygote natives. */
@@ -257,6 +354,7 @@ std::array<JNINativeMethod, 5> g_zygote_methods = {{
              finish_restore_only_child(env, is_child_zygote); // mode 2
            if (is_child_zygote && ctx.pid == 0)
              close_inherited_module_fds();
+           ctx_report_fd_stats(&ctx);
            g_ctx = nullptr;
            return pid;
          })},
@@ -319,6 +417,7 @@ std::array<JNINativeMethod, 5> g_zygote_methods = {{
              finish_restore_only_child(env, is_child_zygote); // mode 2
            if (is_child_zygote && ctx.pid == 0)
              close_inherited_module_fds();
+           ctx_report_fd_stats(&ctx);
            g_ctx = nullptr;
            return pid;
          })},
@@ -343,6 +442,7 @@ std::array<JNINativeMethod, 5> g_zygote_methods = {{
            args.whitelisted_data_info_list = &allowlisted_data_info;
            args.mount_data_dirs = &mount_data_dirs;
            args.mount_storage_dirs = &mount_storage_dirs;
+           yuki::phase::reset(); // USAP: already forked
            bool run_modules = !is_isolated(uid);
            int decision = forked_decision(true, uid);
            if (decision == 2) // denylist + force mode: do not inject
@@ -389,6 +489,7 @@ std::array<JNINativeMethod, 5> g_zygote_methods = {{
            args.mount_data_dirs = &mount_data_dirs;
            args.mount_storage_dirs = &mount_storage_dirs;
            args.mount_sysprop_overrides = &mount_sysprop_overrides;
+           yuki::phase::reset(); // USAP: already forked
            bool run_modules = !is_isolated(uid);
            int decision = forked_decision(true, uid);
            if (decision == 2) // denylist + force mode: do not inject
@@ -442,6 +543,7 @@ std::array<JNINativeMethod, 5> g_zygote_methods = {{
                        permitted_capabilities, effective_capabilities);
        if (ctx.pid == 0)
          zygisk_run_server_post(&args);
+       ctx_report_fd_stats(&ctx);
        g_ctx = nullptr;
        return pid;
      })},
@@ -455,64 +557,181 @@ struct RnFallback {
 };
 std::vector<RnFallback> g_rn_fallback;
 
-void hook_jni_methods(JNIEnv *env, const char *clz, JNINativeMethod *methods,
-                      int count) {
-  jclass clazz = env->FindClass(clz);
-  if (clazz == nullptr) {
+/* Rare fallback for unrelocatable prologues or a failed patch. */
+void rn_fallback(const char *clz, JNINativeMethod &m, void *orig,
+                 std::vector<JNINativeMethod> *to_register) {
+  JNINativeMethod restore{m.name, m.signature, orig};
+  g_rn_fallback.push_back({clz, restore});
+  to_register->push_back(m); // install our wrapper via the native table
+  m.fnPtr = orig;            // wrapper calls back through this
+  ZLOGE("inline hook bailed for %s; RegisterNatives fallback", m.name);
+}
+
+/* Class global refs and method IDs; warmed in zygote, inherited by forks. */
+struct JniMethodId {
+  std::string name;
+  std::string sig;
+  jmethodID mid; // nullptr: looked up and absent
+  bool is_static;
+};
+struct JniClass {
+  std::string name;
+  jclass clazz; // global ref
+  std::vector<JniMethodId> methods;
+};
+std::deque<JniClass> g_jni_classes; // deque: entries stay put as it grows
+
+/* Framework classes modules hook most often; misses are skipped. */
+constexpr const char *kWarmClasses[] = {
+    "android/os/Process",
+    "android/os/SystemProperties",
+    "android/app/ActivityThread",
+};
+
+JniClass *jni_class(JNIEnv *env, const char *name) {
+  for (JniClass &c : g_jni_classes)
+    if (c.name == name)
+      return &c;
+  jclass local = env->FindClass(name);
+  if (local == nullptr) {
     env->ExceptionClear();
-    ZLOGE("FindClass(%s) failed", clz);
-    return;
+    return nullptr;
   }
+  auto global = static_cast<jclass>(env->NewGlobalRef(local));
+  env->DeleteLocalRef(local);
+  if (global == nullptr)
+    return nullptr;
+  g_jni_classes.push_back({name, global, {}});
+  return &g_jni_classes.back();
+}
 
-  std::vector<JNINativeMethod> to_register; // PC-relative prologue fallback
-  for (int i = 0; i < count; ++i) {
-    JNINativeMethod &m = methods[i];
-    if (m.fnPtr == nullptr)
-      continue;
-
-    bool is_static = true;
-    jmethodID mid = env->GetStaticMethodID(clazz, m.name, m.signature);
-    if (mid == nullptr) {
-      env->ExceptionClear();
-      mid = env->GetMethodID(clazz, m.name, m.signature);
-      is_static = false;
+/* Static first, then instance; negative results are cached too. */
+jmethodID jni_method(JNIEnv *env, JniClass *c, const char *name,
+                     const char *sig, bool *is_static) {
+  for (const JniMethodId &m : c->methods)
+    if (m.name == name && m.sig == sig) {
+      *is_static = m.is_static;
+      return m.mid;
     }
-    if (mid == nullptr) {
-      env->ExceptionClear();
-      m.fnPtr = nullptr; // not present on this version
+  bool st = true;
+  jmethodID mid = env->GetStaticMethodID(c->clazz, name, sig);
+  if (mid == nullptr) {
+    env->ExceptionClear();
+    mid = env->GetMethodID(c->clazz, name, sig);
+    st = false;
+  }
+  if (mid == nullptr)
+    env->ExceptionClear();
+  c->methods.push_back({name, sig, mid, st});
+  *is_static = st;
+  return mid;
+}
+
+void warm_jni_cache(JNIEnv *env) {
+  for (const char *name : kWarmClasses)
+    (void)jni_class(env, name);
+}
+
+void drop_jni_cache(JNIEnv *env) {
+  for (JniClass &c : g_jni_classes)
+    env->DeleteGlobalRef(c.clazz);
+  g_jni_classes.clear();
+}
+
+/* Methods of one class for hook_jni_classes. */
+struct JniHookSet {
+  const char *clz;
+  JNINativeMethod *methods;
+  int count;
+};
+
+/*
+ * Inline-hook the natives of several classes; every prologue goes out in one
+ * batched patch. Unrelocatable or failed hooks fall back to RegisterNatives.
+ */
+void hook_jni_classes(JNIEnv *env, const JniHookSet *sets, int nsets) {
+  struct Staged {
+    int set;
+    int index;
+    void *orig;
+    void *wrapper;
+    size_t hook;
+  };
+  std::vector<Staged> staged;
+  std::deque<yuki::ihook::Hook> hooks; // batch keeps pointers into this
+  std::vector<std::vector<JNINativeMethod>> to_register(
+      static_cast<size_t>(nsets)); // PC-relative prologue fallback
+  std::vector<JniClass *> classes(static_cast<size_t>(nsets));
+  yuki::ihook::PatchBatch batch;
+  for (int s = 0; s < nsets; ++s) {
+    const JniHookSet &set = sets[s];
+    JniClass *c = jni_class(env, set.clz);
+    classes[s] = c;
+    if (c == nullptr) {
+      ZLOGE("FindClass(%s) failed", set.clz);
       continue;
     }
+    for (int i = 0; i < set.count; ++i) {
+      JNINativeMethod &m = set.methods[i];
+      if (m.fnPtr == nullptr)
+        continue;
 
-    jobject reflected = env->ToReflectedMethod(clazz, mid, is_static);
-    void *art = yuki::art::art_method_of(env, reflected);
-    void *orig = art ? yuki::art::native_entry(art) : nullptr;
-    env->DeleteLocalRef(reflected);
-    if (orig == nullptr) {
-      ZLOGE("no original entry for %s", m.name);
-      m.fnPtr = nullptr;
-      continue;
+      bool is_static = true;
+      jmethodID mid = jni_method(env, c, m.name, m.signature, &is_static);
+      if (mid == nullptr) {
+        m.fnPtr = nullptr; // not present on this version
+        continue;
+      }
+
+      jobject reflected = env->ToReflectedMethod(c->clazz, mid, is_static);
+      void *art = yuki::art::art_method_of(env, reflected);
+      void *orig = art ? yuki::art::native_entry(art) : nullptr;
+      env->DeleteLocalRef(reflected);
+      if (orig == nullptr) {
+        ZLOGE("no original entry for %s", m.name);
+        m.fnPtr = nullptr;
+        continue;
+      }
+
+      // Patch native body; keep ART entries untouched.
+      void *wrapper = m.fnPtr;
+      yuki::ihook::Hook &h = hooks.emplace_back();
+      void *tramp = yuki::ihook::install(orig, wrapper, &h, &batch);
+      if (tramp != nullptr) {
+        staged.push_back({s, i, orig, wrapper, hooks.size() - 1});
+        m.fnPtr = tramp; // wrapper calls the original via the trampoline
+      } else {
+        rn_fallback(set.clz, m, orig, &to_register[s]);
+      }
     }
+  }
 
-    // Patch native body; keep ART entries untouched.
-    yuki::ihook::Hook h;
-    void *tramp = yuki::ihook::install(orig, m.fnPtr, &h);
-    if (tramp != nullptr) {
+  bool committed = yuki::ihook::commit(&batch);
+  for (const Staged &st : staged) {
+    const JniHookSet &set = sets[st.set];
+    JNINativeMethod &m = set.methods[st.index];
+    yuki::ihook::Hook &h = hooks[st.hook];
+    if (h.active) {
       g_ihooks.push_back(h);
-      m.fnPtr = tramp; // wrapper calls the original via the trampoline
-      ZLOGI("inline-hooked %s @orig=%p tramp=%p", m.name, orig, tramp);
+      ZLOGI("inline-hooked %s @orig=%p tramp=%p", m.name, st.orig, m.fnPtr);
     } else {
-      // Rare fallback for unrelocatable prologues.
-      JNINativeMethod restore{m.name, m.signature, orig};
-      g_rn_fallback.push_back({clz, restore});
-      to_register.push_back(m); // install our wrapper via the native table
-      m.fnPtr = orig;           // wrapper calls back through this
-      ZLOGE("inline hook bailed for %s; RegisterNatives fallback", m.name);
+      m.fnPtr = st.wrapper;
+      rn_fallback(set.clz, m, st.orig, &to_register[st.set]);
     }
   }
+  if (!committed)
+    ZLOGE("batched prologue patch failed for %d class(es)", nsets);
+
+  for (int s = 0; s < nsets; ++s)
+    if (!to_register[s].empty())
+      env->RegisterNatives(classes[s]->clazz, to_register[s].data(),
+                           static_cast<jint>(to_register[s].size()));
+}
 
-  if (!to_register.empty())
-    env->RegisterNatives(clazz, to_register.data(),
-                         static_cast<jint>(to_register.size()));
+void hook_jni_methods(JNIEnv *env, const char *clz, JNINativeMethod *methods,
+                      int count) {
+  JniHookSet set{clz, methods, count};
+  hook_jni_classes(env, &set, 1);
 }
 
 /* Drop the spent AT_ENTRY stub. */
@@ -568,7 +787,9 @@ void hook_zygote_jni() {
   }
   hook_jni_methods(env, kZygote, g_zygote_methods.data(),
                    static_cast<int>(g_zygote_methods.size()));
+  warm_jni_cache(env);
   yz_unmap_injection_stub();
+  zygisk_preload_modules();
   ZLOGI("zygote JNI takeover done");
 }
 
@@ -616,12 +837,90 @@ void zygisk_hook_jni_methods(JNIEnv *env, const char *cls,
   hook_jni_methods(env, cls, methods, n);
 }
 
+namespace {
+
+/*
+ * Module PLT commits stay synchronous, so old_func is valid when
+ * pltHookCommit returns, but within a module phase they share one
+ * /proc/self/maps snapshot. It is rescanned only when a hook names a file
+ * the snapshot has not seen, e.g. a library a module dlopened mid-phase.
+ */
+struct PltQueue {
+  bool in_phase = false;
+  bool have_maps = false;
+  std::vector<lsplt::MapInfo> maps;             // phase snapshot
+  std::vector<std::pair<dev_t, ino_t>> pending; // registered, not committed
+  unsigned phase_commits = 0;
+  unsigned phase_scans = 0;
+  unsigned commits = 0;
+  long commit_ns = 0;
+};
+PltQueue g_plt;
+
+bool plt_snapshot_covers(const std::pair<dev_t, ino_t> &file) {
+  for (const auto &m : g_plt.maps)
+    if (m.dev == file.first && m.inode == file.second)
+      return true;
+  return false;
+}
+
+bool plt_commit_now() {
+  timespec t0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  bool ok = false;
+  if (!g_plt.in_phase) {
+    ok = lsplt::CommitHook();
+  } else {
+    bool stale = !g_plt.have_maps ||
+                 !std::all_of(g_plt.pending.begin(), g_plt.pending.end(),
+                              plt_snapshot_covers);
+    if (stale) {
+      g_plt.maps = lsplt::MapInfo::Scan();
+      g_plt.have_maps = true;
+      ++g_plt.phase_scans;
+    }
+    // lsplt may consume the list it is handed; keep the snapshot intact.
+    std::vector<lsplt::MapInfo> maps = g_plt.maps;
+    ok = lsplt::CommitHook(maps);
+    ++g_plt.phase_commits;
+  }
+  g_plt.commit_ns += elapsed_ns(t0);
+  ++g_plt.commits;
+  g_plt.pending.clear();
+  return ok;
+}
+
+} // namespace
+
 bool zygisk_plt_hook_register(dev_t dev, ino_t inode, const char *symbol,
                               void *new_func, void **old_func) {
-  return lsplt::RegisterHook(dev, inode, symbol, new_func, old_func);
+  if (!lsplt::RegisterHook(dev, inode, symbol, new_func, old_func))
+    return false;
+  g_plt.pending.emplace_back(dev, inode);
+  return true;
 }
 
-bool zygisk_plt_hook_commit() { return lsplt::CommitHook(); }
+bool zygisk_plt_hook_commit() { return plt_commit_now(); }
+
+void zygisk_plt_hook_begin_phase() {
+  g_plt.in_phase = true;
+  g_plt.have_maps = false;
+  g_plt.phase_commits = 0;
+  g_plt.phase_scans = 0;
+}
+
+void zygisk_plt_hook_end_phase(const char *phase) {
+  g_plt.in_phase = false;
+  g_plt.have_maps = false;
+  g_plt.maps.clear();
+  g_plt.maps.shrink_to_fit();
+  if (g_plt.phase_commits == 0)
+    return;
+  ZLOGD("plt commit (%s): %u commit(s) over %u maps scan(s), "
+        "%u commit(s) %ld us total",
+        phase, g_plt.phase_commits, g_plt.phase_scans, g_plt.commits,
+        g_plt.commit_ns / 1000);
+}
 
 bool zygisk_exempt_fd(int fd) {
   if (g_ctx == nullptr || g_ctx->fds_to_ignore == nullptr || fd < 0)
@@ -630,6 +929,16 @@ bool zygisk_exempt_fd(int fd) {
   return true;
 }
 
+void zygisk_track_module_fd(int fd) {
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0)
+    return;
+  for (const ModuleFd &m : g_module_fds)
+    if (m.fd == fd && m.dev == st.st_dev && m.ino == st.st_ino)
+      return;
+  g_module_fds.push_back({fd, st.st_dev, st.st_ino});
+}
+
 bool zygisk_specialize_fully_inline_hooked() {
   return !g_ihooks.empty() && g_rn_fallback.empty();
 }
@@ -639,14 +948,14 @@ void zygisk_self_unhook(JNIEnv *env) {
   for (auto &h : g_ihooks)
     yuki::ihook::uninstall(&h);
   g_ihooks.clear();
-  if (env != nullptr)
+  if (env != nullptr) {
     for (auto &fb : g_rn_fallback) {
-      jclass c = env->FindClass(fb.clz);
-      if (c != nullptr)
-        env->RegisterNatives(c, &fb.m, 1); // fb.m.fnPtr == original entry
-      else
-        env->ExceptionClear();
+      JniClass *c = jni_class(env, fb.clz);
+      if (c != nullptr) // fb.m.fnPtr == original entry
+        env->RegisterNatives(c->clazz, &fb.m, 1);
     }
+    drop_jni_cache(env);
+  }
   g_rn_fallback.clear();
   dev_t dev = 0;
   ino_t inode = 0;
@@ -23,6 +23,8 @@ int zygisk_collect_path_segs(const char *substr, uint64_t *addr, uint64_t *size,
                              int max);
 void zygisk_self_destruct(JNIEnv *env, bool isolated = false);
 void zygisk_load_modules(JNIEnv *env);
+/* Relocate fork-safe modules in zygote so children inherit them. */
+void zygisk_preload_modules();
 void zygisk_run_app_pre(zygisk::AppSpecializeArgs *args);
 void zygisk_run_app_post(const zygisk::AppSpecializeArgs *args);
 void zygisk_run_server_pre(zygisk::ServerSpecializeArgs *args);
@@ -34,5 +36,10 @@ void zygisk_hook_jni_methods(JNIEnv *env, const char *cls,
 bool zygisk_plt_hook_register(dev_t dev, ino_t inode, const char *symbol,
                               void *new_func, void **old_func);
 bool zygisk_plt_hook_commit();
+/* Between these, plt commits share one maps snapshot. */
+void zygisk_plt_hook_begin_phase();
+void zygisk_plt_hook_end_phase(const char *phase);
 
 bool zygisk_exempt_fd(int fd);
+/* Record a module-owned fd for close_inherited_module_fds. */
+void zygisk_track_module_fd(int fd);
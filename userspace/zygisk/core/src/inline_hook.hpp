@@ -12,8 +12,10 @@
 #include <sys/syscall.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <vector>
 
 #ifndef MAP_FIXED_NOREPLACE
 #define MAP_FIXED_NOREPLACE 0x100000
@@ -36,6 +38,16 @@ extern uint8_t yz_cap_tmpl_end[];
 extern uint64_t g_yz_ret_ctx[];
 /* COW patch through zygiskd/kernel. */
 bool yz_patch_text(uintptr_t addr, const void *bytes, unsigned int len);
+struct yz_patch_vec {
+  uintptr_t addr;
+  const void *bytes;
+  unsigned int len;
+};
+/*
+ * Many sites in one zygiskd round trip and one kernel supercall. Returns how
+ * many leading sites may now be patched: n on success, usually 0 on failure.
+ */
+unsigned int yz_patch_text_v(const yz_patch_vec *v, unsigned int n);
 }
 
 namespace yuki::ihook {
@@ -44,10 +56,18 @@ struct Hook {
   uint32_t *target = nullptr; // patched function start
   uint32_t saved[2] = {};     // original 2 instructions (paciasp + sub-sp)
   void *trampoline =
-      nullptr; // R-X near page: capture stub + [2 insns + B back]
+      nullptr; // slab slot: capture stub + [2 insns + B back]
   bool active = false;
 };
 
+/* Prologue patches staged by install() and applied together by commit(). */
+struct PatchBatch {
+  static constexpr unsigned kMax = 32;
+  Hook *hooks[kMax] = {};
+  uint32_t patch[kMax][2] = {};
+  unsigned n = 0;
+};
+
 /* PC-relative instructions cannot be copied. */
 inline bool is_pcrel(uint32_t i) {
   if ((i & 0x1F000000u) == 0x10000000u) // ADR / ADRP
@@ -89,12 +109,13 @@ inline int make_exec_memfd() {
   return fd;
 }
 
+constexpr uintptr_t kReach = 0x7800000; // ~120MB, comfortably under +-128MB
+
 /* Allocate a reachable trampoline page. */
 inline ExecPage alloc_near(uintptr_t target) {
-  const uintptr_t reach = 0x7800000; // ~120MB, comfortably under B's +-128MB
   uintptr_t base = target & ~static_cast<uintptr_t>(0xFFF);
   int fd = make_exec_memfd();
-  for (uintptr_t off = 0x10000; off <= reach; off += 0x10000) {
+  for (uintptr_t off = 0x10000; off + 0x1000 < kReach; off += 0x10000) {
     for (int up = 0; up < 2; ++up) {
       uintptr_t hint = up ? base + off : base - off;
       if (fd >= 0) {
@@ -141,8 +162,185 @@ inline const char *tramp_vma_name() {
   return name;
 }
 
-/* Patch target prologue and return call-original trampoline. */
-inline void *install(void *target, void *replacement, Hook *out) {
+/*
+ * Trampoline slab: each near page is carved into fixed-size slots so a module
+ * with many hooks shares a few pages. File-backed pages keep their R-X view
+ * mapped at all times and are written through a temporary RW alias; anonymous
+ * fallback pages flip RW -> R-X once and are never reopened, so live stubs
+ * never lose PROT_EXEC. File-backed pages stay shared across fork, so a page
+ * only takes new slots in the process that mapped it; children of zygote get
+ * pages of their own.
+ */
+struct SlabPage {
+  uint8_t *addr = nullptr;  // R-X view the patched prologues branch to
+  uint8_t *alias = nullptr; // RW view while open (file-backed only)
+  pid_t owner = 0;          // process that mapped the page
+  bool file_backed = false;
+  bool open = false;   // writable, sealed by the next commit
+  bool frozen = false; // cannot be reopened for new slots
+  uint64_t used = 0;   // slot bitmap
+};
+
+inline std::vector<SlabPage> g_slab;
+
+constexpr unsigned kSlotsMax = 64;
+
+/* Capture stub + call-original tail, 16-aligned. */
+inline size_t slot_size() {
+  const size_t cap = static_cast<size_t>(yz_cap_tmpl_end - yz_cap_tmpl);
+  return (((cap + 3U) & ~static_cast<size_t>(3)) + 12U + 15U) &
+         ~static_cast<size_t>(15);
+}
+
+inline uint64_t slot_mask() {
+  size_t n = std::min<size_t>(0x1000 / slot_size(), kSlotsMax);
+  return n == 64 ? ~0ULL : (1ULL << n) - 1;
+}
+
+inline bool page_reachable(const SlabPage &p, uintptr_t target) {
+  auto dist = [](uintptr_t a, uintptr_t b) { return a > b ? a - b : b - a; };
+  auto lo = reinterpret_cast<uintptr_t>(p.addr);
+  return std::max(dist(lo, target), dist(lo + 0x1000, target)) < kReach;
+}
+
+inline void seal_page(SlabPage *p);
+
+/* Make a page writable for new slots; commit() or seal_page() undoes it. */
+inline bool open_page(SlabPage *p) {
+  if (p->owner != getpid()) {
+    seal_page(p); // drops an alias inherited mid-batch; the page stays shared
+    p->frozen = true;
+    return false;
+  }
+  if (p->open)
+    return true;
+  if (p->frozen)
+    return false;
+  // old_size 0 duplicates a shared mapping; the memfd itself is long closed.
+  void *a = mremap(p->addr, 0, 0x1000, MREMAP_MAYMOVE);
+  if (a == MAP_FAILED || mprotect(a, 0x1000, PROT_READ | PROT_WRITE) != 0) {
+    if (a != MAP_FAILED)
+      munmap(a, 0x1000);
+    p->frozen = true;
+    return false;
+  }
+  p->alias = static_cast<uint8_t *>(a);
+  p->open = true;
+  return true;
+}
+
+inline void seal_page(SlabPage *p) {
+  if (!p->open)
+    return;
+  if (p->file_backed) {
+    munmap(p->alias, 0x1000);
+    p->alias = nullptr;
+  } else {
+    mprotect(p->addr, 0x1000, PROT_READ | PROT_EXEC);
+    prctl(PR_SET_VMA, PR_SET_VMA_ANON_NAME, p->addr, 0x1000,
+          tramp_vma_name());
+    p->frozen = true;
+  }
+  __builtin___clear_cache(reinterpret_cast<char *>(p->addr),
+                          reinterpret_cast<char *>(p->addr) + 0x1000);
+  p->open = false;
+}
+
+/* Seal every open page: one W^X transition per page per commit. */
+inline void seal_all() {
+  for (SlabPage &p : g_slab)
+    seal_page(&p);
+}
+
+/* Claim a slot reachable from target; *page receives its g_slab index. */
+inline uint8_t *alloc_slot(uintptr_t target, size_t *page) {
+  const uint64_t full = slot_mask();
+  if (full == 0)
+    return nullptr; // capture stub larger than a page
+  for (size_t i = 0; i < g_slab.size(); ++i) {
+    SlabPage &p = g_slab[i];
+    if (p.used == full || !page_reachable(p, target) || !open_page(&p))
+      continue;
+    auto slot = static_cast<unsigned>(__builtin_ctzll(~p.used));
+    p.used |= 1ULL << slot;
+    *page = i;
+    return p.addr + slot * slot_size();
+  }
+  ExecPage ep = alloc_near(target);
+  if (ep.addr == nullptr)
+    return nullptr;
+  SlabPage p;
+  p.addr = static_cast<uint8_t *>(ep.addr);
+  p.owner = getpid();
+  p.file_backed = ep.file_backed;
+  p.open = true;
+  p.used = 1;
+  if (ep.file_backed) {
+    void *a = mmap(nullptr, 0x1000, PROT_READ | PROT_WRITE, MAP_SHARED, ep.fd,
+                   0);
+    close(ep.fd);
+    if (a == MAP_FAILED) {
+      munmap(ep.addr, 0x1000);
+      return nullptr;
+    }
+    p.alias = static_cast<uint8_t *>(a);
+  }
+  g_slab.push_back(p);
+  *page = g_slab.size() - 1;
+  return p.addr;
+}
+
+/* Release a slot; the page goes once its last slot does. */
+inline void free_slot(void *slot) {
+  auto s = reinterpret_cast<uintptr_t>(slot);
+  for (auto it = g_slab.begin(); it != g_slab.end(); ++it) {
+    auto lo = reinterpret_cast<uintptr_t>(it->addr);
+    if (s < lo || s >= lo + 0x1000)
+      continue;
+    it->used &= ~(1ULL << ((s - lo) / slot_size()));
+    if (it->used == 0) {
+      if (it->alias != nullptr)
+        munmap(it->alias, 0x1000);
+      munmap(it->addr, 0x1000);
+      g_slab.erase(it);
+    }
+    return;
+  }
+}
+
+/*
+ * Make a staged slot callable before commit(): file-backed pages already map
+ * it R-X and only need the icache flushed, anonymous pages are sealed.
+ */
+inline void publish_slot(void *slot) {
+  auto s = reinterpret_cast<uintptr_t>(slot);
+  for (SlabPage &p : g_slab) {
+    auto lo = reinterpret_cast<uintptr_t>(p.addr);
+    if (s < lo || s >= lo + 0x1000)
+      continue;
+    if (p.file_backed)
+      __builtin___clear_cache(static_cast<char *>(slot),
+                              static_cast<char *>(slot) + slot_size());
+    else
+      seal_page(&p);
+    return;
+  }
+}
+
+/* Pages and live slots held by the slab. */
+inline void slab_usage(unsigned *pages, unsigned *slots) {
+  *pages = static_cast<unsigned>(g_slab.size());
+  *slots = 0;
+  for (const SlabPage &p : g_slab)
+    *slots += static_cast<unsigned>(__builtin_popcountll(p.used));
+}
+
+/*
+ * Patch target prologue and return call-original trampoline. With a batch the
+ * patch is only staged; the hook goes live on commit().
+ */
+inline void *install(void *target, void *replacement, Hook *out,
+                     PatchBatch *batch = nullptr) {
   auto *t = reinterpret_cast<uint32_t *>(target);
   for (int i = 0; i < 2; ++i)
     if (is_pcrel(t[i]))
@@ -154,13 +352,13 @@ inline void *install(void *target, void *replacement, Hook *out) {
   const size_t co_off = (cap_size + 3U) & ~static_cast<size_t>(3); // 4-aligned
 
   // Trampoline must be branch-reachable.
-  ExecPage page = alloc_near(reinterpret_cast<uintptr_t>(target));
-  if (page.addr == nullptr)
+  size_t pi = 0;
+  uint8_t *slot = alloc_slot(reinterpret_cast<uintptr_t>(target), &pi);
+  if (slot == nullptr)
     return nullptr;
-  uint8_t file_page[0x1000] = {};
-  auto *base =
-      page.file_backed ? file_page : reinterpret_cast<uint8_t *>(page.addr);
-  auto *mapped_base = reinterpret_cast<uint8_t *>(page.addr);
+  SlabPage &page = g_slab[pi];
+  uint8_t *base =
+      page.alias != nullptr ? page.alias + (slot - page.addr) : slot;
   // Capture stub.
   memcpy(base, yz_cap_tmpl, cap_size);
   *reinterpret_cast<uint64_t *>(base + ctx_off) =
@@ -169,52 +367,104 @@ inline void *install(void *target, void *replacement, Hook *out) {
       reinterpret_cast<uint64_t>(replacement);
   // Call-original trampoline.
   auto *co = reinterpret_cast<uint32_t *>(base + co_off);
-  auto *mapped_co = reinterpret_cast<uint32_t *>(mapped_base + co_off);
+  auto *mapped_co = reinterpret_cast<uint32_t *>(slot + co_off);
   for (int i = 0; i < 2; ++i) {
     out->saved[i] = t[i];
     co[i] = t[i];
   }
   co[2] = enc_b(reinterpret_cast<uintptr_t>(mapped_co + 2),
                 reinterpret_cast<uintptr_t>(target) + 8);
-  if (page.file_backed) {
-    if (pwrite(page.fd, file_page, sizeof(file_page), 0) !=
-        static_cast<ssize_t>(sizeof(file_page))) {
-      munmap(page.addr, 0x1000);
-      close(page.fd);
-      return nullptr;
-    }
-    close(page.fd);
-  } else {
-    __builtin___clear_cache(
-        reinterpret_cast<char *>(page.addr),
-        reinterpret_cast<char *>(mapped_base + co_off + 12));
-    mprotect(page.addr, 0x1000, PROT_READ | PROT_EXEC);
-    prctl(PR_SET_VMA, PR_SET_VMA_ANON_NAME, page.addr, 0x1000,
-          tramp_vma_name());
-  }
-  __builtin___clear_cache(reinterpret_cast<char *>(page.addr),
-                          reinterpret_cast<char *>(mapped_base + co_off + 12));
 
   // BTI landing pad + direct branch to capture stub.
   uint32_t patch[2] = {
       0xD503245F, // BTI c
       enc_b(reinterpret_cast<uintptr_t>(target) + 4,
-            reinterpret_cast<uintptr_t>(page.addr)), // B <capture stub>
+            reinterpret_cast<uintptr_t>(slot)), // B <capture stub>
   };
+  out->target = t;
+  out->trampoline = slot;
+  if (batch != nullptr && batch->n < PatchBatch::kMax) {
+    batch->hooks[batch->n] = out;
+    memcpy(batch->patch[batch->n], patch, sizeof(patch));
+    ++batch->n;
+    return mapped_co; // page is sealed by commit()
+  }
+  seal_page(&page);
   if (!yz_patch_text(reinterpret_cast<uintptr_t>(target), patch,
                      sizeof(patch))) {
-    munmap(page.addr, 0x1000);
+    free_slot(slot);
+    out->trampoline = nullptr;
     return nullptr;
   }
   __builtin___clear_cache(reinterpret_cast<char *>(target),
                           reinterpret_cast<char *>(target) + 8);
 
-  out->target = t;
-  out->trampoline = page.addr;
   out->active = true;
   return mapped_co; // wrapper reaches the ORIGINAL native via this trampoline
 }
 
+/*
+ * Apply every staged patch at once. Hooks whose prologue may have been
+ * written stay active; only the trampolines of the rest are freed, since a
+ * written prologue keeps branching into its slot.
+ */
+inline bool commit(PatchBatch *batch) {
+  seal_all(); // stubs must be executable before any prologue points at them
+  if (batch->n == 0)
+    return true;
+  yz_patch_vec vec[PatchBatch::kMax];
+  for (unsigned i = 0; i < batch->n; ++i)
+    vec[i] = {reinterpret_cast<uintptr_t>(batch->hooks[i]->target),
+              batch->patch[i], sizeof(batch->patch[i])};
+  unsigned applied = yz_patch_text_v(vec, batch->n);
+  if (applied != 0) {
+    // One icache flush per page touched.
+    std::sort(vec, vec + applied,
+              [](const yz_patch_vec &a, const yz_patch_vec &b) {
+                return a.addr < b.addr;
+              });
+    for (unsigned i = 0; i < applied;) {
+      uintptr_t page = vec[i].addr & ~static_cast<uintptr_t>(0xFFF);
+      uintptr_t end = vec[i].addr + vec[i].len;
+      unsigned j = i + 1;
+      for (; j < applied &&
+             (vec[j].addr & ~static_cast<uintptr_t>(0xFFF)) == page;
+           ++j)
+        end = std::max(end, vec[j].addr + vec[j].len);
+      __builtin___clear_cache(reinterpret_cast<char *>(vec[i].addr),
+                              reinterpret_cast<char *>(end));
+      i = j;
+    }
+  }
+  for (unsigned i = 0; i < batch->n; ++i) {
+    Hook *h = batch->hooks[i];
+    if (i < applied) {
+      h->active = true;
+    } else {
+      free_slot(h->trampoline);
+      h->trampoline = nullptr;
+    }
+  }
+  bool ok = applied == batch->n;
+  batch->n = 0;
+  return ok;
+}
+
+/* Drop a hook still staged in batch; its slot is freed. */
+inline bool unstage(PatchBatch *batch, Hook *h) {
+  for (unsigned i = 0; i < batch->n; ++i) {
+    if (batch->hooks[i] != h)
+      continue;
+    --batch->n;
+    batch->hooks[i] = batch->hooks[batch->n];
+    memcpy(batch->patch[i], batch->patch[batch->n], sizeof(batch->patch[i]));
+    free_slot(h->trampoline);
+    h->trampoline = nullptr;
+    return true;
+  }
+  return false;
+}
+
 /* Restore by discarding the COW patch page. */
 inline void uninstall(Hook *h) {
   if (!h->active)
@@ -225,7 +475,7 @@ inline void uninstall(Hook *h) {
   __builtin___clear_cache(reinterpret_cast<char *>(h->target),
                           reinterpret_cast<char *>(h->target) + 8);
   if (h->trampoline != nullptr)
-    munmap(h->trampoline, 0x1000);
+    free_slot(h->trampoline);
   h->trampoline = nullptr;
   h->active = false;
 }
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-3.0 */
+/*
+ * YukiZygisk batched text patch request, shared by libzygisk and yukizncore.
+ *
+ * Author: Anatdx
+ */
+#pragma once
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "inline_hook.hpp"
+#include "uapi/yukizygisk.h"
+
+namespace yuki::patch {
+
+/*
+ * Send v[0..n) as one PatchTextBatch request (op) on a connected zygiskd
+ * socket. Returns how many leading sites may now be patched; 0 on error.
+ */
+inline unsigned int send_batch(int sock, uint8_t op, const yz_patch_vec *v,
+                               unsigned int n) {
+  if (sock < 0 || v == nullptr || n == 0 || n > YZ_PATCH_BATCH_MAX)
+    return 0;
+  uint32_t data_len = 0;
+  for (unsigned int i = 0; i < n; ++i) {
+    if (v[i].bytes == nullptr || v[i].len == 0 ||
+        v[i].len > YZ_PATCH_BATCH_BYTES - data_len)
+      return 0;
+    data_len += v[i].len;
+  }
+  // One message: op, count, data_len, entries[count], payload.
+  const size_t head = 1 + (2 * sizeof(uint32_t));
+  const size_t ents = n * sizeof(yz_patch_text_entry);
+  std::vector<uint8_t> msg(head + ents + data_len);
+  msg[0] = op;
+  uint32_t n32 = n;
+  memcpy(&msg[1], &n32, sizeof(n32));
+  memcpy(&msg[1 + sizeof(n32)], &data_len, sizeof(data_len));
+  uint32_t off = 0;
+  for (unsigned int i = 0; i < n; ++i) {
+    yz_patch_text_entry e{};
+    e.addr = v[i].addr;
+    e.len = v[i].len;
+    e.off = off;
+    memcpy(&msg[head + (i * sizeof(e))], &e, sizeof(e));
+    memcpy(&msg[head + ents + off], v[i].bytes, v[i].len);
+    off += v[i].len;
+  }
+
+  for (size_t done = 0; done < msg.size();) {
+    ssize_t w = write(sock, msg.data() + done, msg.size() - done);
+    if (w <= 0)
+      return 0;
+    done += static_cast<size_t>(w);
+  }
+  uint32_t applied = 0;
+  auto *p = reinterpret_cast<uint8_t *>(&applied);
+  for (size_t got = 0; got < sizeof(applied);) {
+    ssize_t r = read(sock, p + got, sizeof(applied) - got);
+    if (r <= 0)
+      return 0;
+    got += static_cast<size_t>(r);
+  }
+  return applied < n ? applied : n;
+}
+
+} // namespace yuki::patch
@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: GPL-3.0 */
+/*
+ * YukiZygisk specialization phase recorder.
+ *
+ * Author: Anatdx
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+namespace yuki::phase {
+
+/* Mirrors zygiskd::SpecPhase. */
+enum Id : uint8_t {
+  kForkPre = 0,
+  kFdSanitize,
+  kGetFlags,
+  kModuleLoad,
+  kOnLoad,
+  kPreSpecialize,
+  kPostSpecialize,
+  kHideSolist,
+  kSpoofMaps,
+  kSelfUnmap, // wire slot only: denylisted processes do not report
+  kCount,
+};
+
+constexpr uint32_t kModuleMax = 16;
+
+struct ModuleNs {
+  uint32_t index;
+  uint64_t load;
+  uint64_t onload;
+  uint64_t pre;
+  uint64_t post;
+};
+
+/* Child-local record, reset at fork and reported once by the core. */
+struct Record {
+  uint32_t mask;
+  uint64_t ns[kCount];
+  uint32_t module_count;
+  ModuleNs modules[kModuleMax];
+};
+
+inline Record g_record{};
+
+inline uint64_t now_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL) +
+         static_cast<uint64_t>(ts.tv_nsec);
+}
+
+inline void reset() { memset(&g_record, 0, sizeof(g_record)); }
+
+inline void add(Id id, uint64_t ns) {
+  g_record.mask |= 1U << id;
+  g_record.ns[id] += ns;
+}
+
+/* Per-module slot; nullptr once kModuleMax modules are tracked. */
+inline ModuleNs *module(uint32_t index) {
+  for (uint32_t i = 0; i < g_record.module_count; ++i)
+    if (g_record.modules[i].index == index)
+      return &g_record.modules[i];
+  if (g_record.module_count == kModuleMax)
+    return nullptr;
+  ModuleNs *m = &g_record.modules[g_record.module_count++];
+  m->index = index;
+  return m;
+}
+
+/* Adds the scope's lifetime to a phase and, optionally, a module counter. */
+class Scope {
+public:
+  explicit Scope(Id id, uint64_t *module_ns = nullptr)
+      : id_(id), module_ns_(module_ns), t0_(now_ns()) {}
+  ~Scope() {
+    uint64_t d = now_ns() - t0_;
+    add(id_, d);
+    if (module_ns_ != nullptr)
+      *module_ns_ += d;
+  }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  Id id_;
+  uint64_t *module_ns_;
+  uint64_t t0_;
+};
+
+} // namespace yuki::phase
@@ -15,9 +15,10 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <cstdint>
-#include <cstdio>
 #include <cstring>
+#include <ctime>
 
 #ifndef PR_SET_VMA
 #define PR_SET_VMA 0x53564d41
@@ -59,116 +60,234 @@ inline uintptr_t page_up(uintptr_t addr, size_t pg) {
   return (addr + pg - 1) & ~(static_cast<uintptr_t>(pg) - 1);
 }
 
-class LinkerSyms {
-public:
-  LinkerSyms() = default;
-  LinkerSyms(const LinkerSyms &) = delete;
-  LinkerSyms &operator=(const LinkerSyms &) = delete;
-  LinkerSyms(LinkerSyms &&) = delete;
-  LinkerSyms &operator=(LinkerSyms &&) = delete;
+/* One /proc/self/maps line; path points into the reader's buffer. */
+struct MapEntry {
+  uintptr_t start = 0;
+  uintptr_t end = 0;
+  char perms[5] = {};
+  const char *path = ""; // "" for bare anonymous mappings
+};
 
-  bool init() {
-    if (!find_linker_base())
-      return false;
-    if (!map_and_parse())
-      return false;
-    return symtab_ != nullptr && strtab_ != nullptr;
+uintptr_t parse_hex(const char **p) {
+  uintptr_t v = 0;
+  for (;; ++*p) {
+    char c = **p;
+    if (c >= '0' && c <= '9')
+      v = (v << 4) | static_cast<uintptr_t>(c - '0');
+    else if (c >= 'a' && c <= 'f')
+      v = (v << 4) | static_cast<uintptr_t>(c - 'a' + 10);
+    else
+      return v;
   }
+}
 
-  ~LinkerSyms() {
-    if (map_ != MAP_FAILED && map_ != nullptr)
-      munmap(map_, map_sz_);
+bool parse_map_line(const char *p, MapEntry *e) {
+  e->start = parse_hex(&p);
+  if (*p++ != '-')
+    return false;
+  e->end = parse_hex(&p);
+  if (*p++ != ' ')
+    return false;
+  for (int i = 0; i < 4; ++i) {
+    if (*p == '\0')
+      return false;
+    e->perms[i] = *p++;
   }
-
-  uintptr_t find(const char *prefix) const {
-    const size_t plen = strlen(prefix);
-    for (size_t i = 0; i < sym_cnt_; ++i) {
-      const Elf64_Sym &s = symtab_[i];
-      if (s.st_name == 0 || s.st_value == 0)
-        continue;
-      const char *name = strtab_ + s.st_name;
-      if (strncmp(name, prefix, plen) == 0)
-        return base_ + s.st_value;
-    }
-    return 0;
+  for (int field = 0; field < 3; ++field) { /* offset, dev, inode */
+    while (*p == ' ')
+      ++p;
+    while (*p != '\0' && *p != ' ')
+      ++p;
   }
+  while (*p == ' ')
+    ++p;
+  e->path = p;
+  return e->end > e->start;
+}
 
-  [[nodiscard]] uintptr_t base() const { return base_; }
+inline int perms_prot(const char *perms) {
+  return (perms[0] == 'r' ? PROT_READ : 0) |
+         (perms[1] == 'w' ? PROT_WRITE : 0) |
+         (perms[2] == 'x' ? PROT_EXEC : 0);
+}
 
-private:
-  bool find_linker_base() {
-    FILE *fp = fopen("/proc/self/maps", "re");
-    if (fp == nullptr)
-      return false;
-    char line[512];
-    while (fgets(line, sizeof(line), fp) != nullptr) {
-      if (strstr(line, "/linker64") == nullptr)
-        continue;
-      unsigned long start = 0;
-      if (sscanf(line, "%lx-", &start) != 1)
-        continue;
-      base_ = start;
-      const char *slash = strchr(line, '/');
-      if (slash != nullptr) {
-        size_t n = strlen(slash);
-        while (n > 0 && (slash[n - 1] == '\n' || slash[n - 1] == ' '))
-          --n;
-        if (n < sizeof(path_)) {
-          memcpy(path_, slash, n);
-          path_[n] = '\0';
-        }
-      }
+/*
+ * Stream /proc/self/maps through a stack buffer: no stdio, no heap. Stops
+ * early when fn returns false. Lines longer than the buffer are skipped.
+ */
+template <class F> void for_each_map(F &&fn) {
+  int fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+  char buf[4096];
+  size_t len = 0;
+  bool skip = false;
+  bool stop = false;
+  while (!stop) {
+    ssize_t r = read(fd, buf + len, sizeof(buf) - len);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
       break;
+    len += static_cast<size_t>(r);
+    size_t pos = 0;
+    while (!stop) {
+      auto *nl = static_cast<char *>(memchr(buf + pos, '\n', len - pos));
+      if (nl == nullptr)
+        break;
+      *nl = '\0';
+      MapEntry e;
+      if (!skip && parse_map_line(buf + pos, &e))
+        stop = !fn(static_cast<const MapEntry &>(e));
+      skip = false;
+      pos = static_cast<size_t>(nl - buf) + 1;
+    }
+    if (pos == 0 && len == sizeof(buf)) {
+      skip = true; /* overlong line: drop it up to its newline */
+      len = 0;
+      continue;
     }
-    (void)fclose(fp);
-    return base_ != 0 && path_[0] != '\0';
+    memmove(buf, buf + pos, len - pos);
+    len -= pos;
   }
+  close(fd);
+}
 
-  bool map_and_parse() {
-    int fd = open(path_, O_RDONLY | O_CLOEXEC);
-    if (fd < 0)
-      return false;
-    struct stat st{};
-    if (fstat(fd, &st) != 0 || st.st_size < 0 ||
-        static_cast<uint64_t>(st.st_size) < sizeof(Elf64_Ehdr)) {
-      close(fd);
-      return false;
+/* Linker symbols used here; resolved together in one .symtab pass. */
+enum LinkerSym : uint8_t {
+  kSymSolinker,
+  kSymSolist,
+  kSymSomain,
+  kSymVdso,
+  kSymSoinfoUnload,
+  kSymLoadCounter,
+  kSymUnloadCounter,
+  kSymGetRealpath,
+  kSymGetSoname,
+  kSymGuardC2,
+  kSymGuardC1,
+  kSymGuardD2,
+  kSymGuardD1,
+  kLinkerSymCount,
+};
+
+/* Prefixes; the first .symtab entry matching each one wins. */
+constexpr const char *kLinkerSymNames[kLinkerSymCount] = {
+    "__dl__ZL8solinker",
+    "__dl__ZL6solist",
+    "__dl__ZL6somain",
+    "__dl__ZL4vdso",
+    "__dl__ZL13soinfo_unloadP6soinfo",
+    "__dl__ZL21g_module_load_counter",
+    "__dl__ZL23g_module_unload_counter",
+    "__dl__ZNK6soinfo12get_realpathEv",
+    "__dl__ZNK6soinfo10get_sonameEv",
+    "__dl__ZN18ProtectedDataGuardC2Ev",
+    "__dl__ZN18ProtectedDataGuardC1Ev",
+    "__dl__ZN18ProtectedDataGuardD2Ev",
+    "__dl__ZN18ProtectedDataGuardD1Ev",
+};
+constexpr char kLinkerSymCommon[] = "__dl__Z";
+
+/* Process-wide; built once (in zygote when prepared) and inherited COW. */
+struct LinkerView {
+  bool done = false;
+  bool ok = false;
+  uintptr_t base = 0;
+  uintptr_t addr[kLinkerSymCount] = {};
+};
+LinkerView g_linker;
+
+bool find_linker_base(uintptr_t *base, char *path, size_t path_sz) {
+  for_each_map([&](const MapEntry &e) {
+    if (strstr(e.path, "/linker64") == nullptr)
+      return true;
+    *base = e.start;
+    size_t n = strlen(e.path);
+    while (n > 0 && e.path[n - 1] == ' ')
+      --n;
+    if (n < path_sz) {
+      memcpy(path, e.path, n);
+      path[n] = '\0';
     }
-    map_sz_ = (size_t)st.st_size;
-    map_ = mmap(nullptr, map_sz_, PROT_READ, MAP_PRIVATE, fd, 0);
-    close(fd);
-    if (map_ == MAP_FAILED)
-      return false;
+    return false;
+  });
+  return *base != 0 && path[0] != '\0';
+}
 
-    const auto *base = static_cast<const uint8_t *>(map_);
-    const auto *eh = reinterpret_cast<const Elf64_Ehdr *>(base);
-    if (memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
-        eh->e_ident[EI_CLASS] != ELFCLASS64)
-      return false;
+/* Map linker64 and fill every wanted address in a single .symtab walk. */
+bool resolve_linker_syms(const char *path, uintptr_t base, uintptr_t *addr) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  struct stat st{};
+  if (fstat(fd, &st) != 0 || st.st_size < 0 ||
+      static_cast<uint64_t>(st.st_size) < sizeof(Elf64_Ehdr)) {
+    close(fd);
+    return false;
+  }
+  size_t map_sz = static_cast<size_t>(st.st_size);
+  void *map = mmap(nullptr, map_sz, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
 
-    const auto *sh = reinterpret_cast<const Elf64_Shdr *>(base + eh->e_shoff);
+  const auto *file = static_cast<const uint8_t *>(map);
+  const auto *eh = reinterpret_cast<const Elf64_Ehdr *>(file);
+  const Elf64_Sym *symtab = nullptr;
+  const char *strtab = nullptr;
+  size_t sym_cnt = 0;
+  if (memcmp(eh->e_ident, ELFMAG, SELFMAG) == 0 &&
+      eh->e_ident[EI_CLASS] == ELFCLASS64) {
+    const auto *sh = reinterpret_cast<const Elf64_Shdr *>(file + eh->e_shoff);
     for (size_t i = 0; i < eh->e_shnum; ++i) {
-      if (sh[i].sh_type != SHT_SYMTAB)
+      if (sh[i].sh_type != SHT_SYMTAB || sh[i].sh_link >= eh->e_shnum)
         continue;
-      if (sh[i].sh_link >= eh->e_shnum)
-        return false;
-      symtab_ = reinterpret_cast<const Elf64_Sym *>(base + sh[i].sh_offset);
-      sym_cnt_ = sh[i].sh_size / sizeof(Elf64_Sym);
-      strtab_ =
-          reinterpret_cast<const char *>(base + sh[sh[i].sh_link].sh_offset);
-      return true;
+      symtab = reinterpret_cast<const Elf64_Sym *>(file + sh[i].sh_offset);
+      sym_cnt = sh[i].sh_size / sizeof(Elf64_Sym);
+      strtab =
+          reinterpret_cast<const char *>(file + sh[sh[i].sh_link].sh_offset);
+      break;
     }
-    return false; /* stripped .symtab -- give up */
   }
 
-  uintptr_t base_ = 0;
-  char path_[256] = {};
-  void *map_ = MAP_FAILED;
-  size_t map_sz_ = 0;
-  const Elf64_Sym *symtab_ = nullptr;
-  const char *strtab_ = nullptr;
-  size_t sym_cnt_ = 0;
-};
+  size_t plen[kLinkerSymCount];
+  for (size_t k = 0; k < kLinkerSymCount; ++k)
+    plen[k] = strlen(kLinkerSymNames[k]);
+  const size_t common = sizeof(kLinkerSymCommon) - 1;
+  size_t left = kLinkerSymCount;
+  for (size_t i = 0; i < sym_cnt && left > 0; ++i) {
+    const Elf64_Sym &s = symtab[i];
+    if (s.st_name == 0 || s.st_value == 0)
+      continue;
+    const char *name = strtab + s.st_name;
+    if (strncmp(name, kLinkerSymCommon, common) != 0)
+      continue;
+    for (size_t k = 0; k < kLinkerSymCount; ++k) {
+      if (addr[k] == 0 && strncmp(name, kLinkerSymNames[k], plen[k]) == 0) {
+        addr[k] = base + s.st_value;
+        --left;
+      }
+    }
+  }
+  munmap(map, map_sz);
+  return symtab != nullptr; /* stripped .symtab -- give up */
+}
+
+const LinkerView &linker_view() {
+  if (g_linker.done)
+    return g_linker;
+  g_linker.done = true;
+  char path[256] = {};
+  g_linker.ok = find_linker_base(&g_linker.base, path, sizeof(path)) &&
+                resolve_linker_syms(path, g_linker.base, g_linker.addr);
+  return g_linker;
+}
+
+inline uintptr_t linker_sym(LinkerSym s) { return g_linker.addr[s]; }
+inline uintptr_t linker_sym(LinkerSym s, LinkerSym fallback) {
+  return g_linker.addr[s] != 0 ? g_linker.addr[s] : g_linker.addr[fallback];
+}
 
 inline void *soinfo_next(void *si) {
   return *reinterpret_cast<void **>(reinterpret_cast<uintptr_t>(si) +
@@ -254,41 +373,89 @@ bool u_probe_offsets(void *somain, void *solinker, void *vdso,
   return size_ok && next_ok && ctor_ok;
 }
 
+/* First 8 bytes of the mapped linker's GNU build-id; 0 if it has none. */
+uint64_t linker_build_id() {
+  const auto *eh = reinterpret_cast<const ElfW(Ehdr) *>(g_linker.base);
+  if (eh == nullptr || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0)
+    return 0;
+  const auto *ph =
+      reinterpret_cast<const ElfW(Phdr) *>(g_linker.base + eh->e_phoff);
+  for (int i = 0; i < eh->e_phnum; ++i) {
+    if (ph[i].p_type != PT_NOTE)
+      continue;
+    uintptr_t p = g_linker.base + ph[i].p_vaddr;
+    uintptr_t end = p + ph[i].p_memsz;
+    while (p + sizeof(ElfW(Nhdr)) <= end) {
+      const auto *nh = reinterpret_cast<const ElfW(Nhdr) *>(p);
+      uintptr_t name = p + sizeof(*nh);
+      uintptr_t desc = name + ((nh->n_namesz + 3U) & ~3U);
+      if (nh->n_type == NT_GNU_BUILD_ID && nh->n_namesz == 4 &&
+          memcmp(reinterpret_cast<const void *>(name), "GNU", 4) == 0 &&
+          nh->n_descsz >= sizeof(uint64_t) && desc + sizeof(uint64_t) <= end) {
+        uint64_t id = 0;
+        memcpy(&id, reinterpret_cast<const void *>(desc), sizeof(id));
+        return id;
+      }
+      p = desc + ((nh->n_descsz + 3U) & ~3U);
+    }
+  }
+  return 0;
+}
+
+SoinfoLayout g_offered{};
+SoinfoLayout g_probed{};
+
+/* The same invariants the probe keys on, checked at the offered offsets. */
+bool u_adopt_offsets(const SoinfoLayout &l, void *somain, void *solinker,
+                     void *vdso, const char *linker_path) {
+  if (l.linker_id == 0 || l.linker_id != linker_build_id() ||
+      l.size_off % sizeof(void *) != 0 || l.next_off % sizeof(void *) != 0 ||
+      l.size_off >= kSizeBlockRange || l.next_off >= kSizeBlockRange ||
+      l.ctor_off >= kSizeBlockRange || l.ctor_off < sizeof(link_map))
+    return false;
+  auto at = [](void *si, size_t off) {
+    return reinterpret_cast<uintptr_t>(si) + off;
+  };
+  size_t size = *reinterpret_cast<size_t *>(at(somain, l.size_off));
+  void *nx = *reinterpret_cast<void **>(at(solinker, l.next_off));
+  size_t gap = (sizeof(link_map) + sizeof(void *) - 1) / sizeof(void *);
+  auto *lm = reinterpret_cast<link_map *>(
+      at(solinker, l.ctor_off - (gap * sizeof(void *))));
+  if (size <= kSizeMin || size >= kSizeMax ||
+      !(nx == somain || (vdso != nullptr && nx == vdso)) ||
+      !*reinterpret_cast<bool *>(at(solinker, l.ctor_off)) ||
+      lm->l_addr == 0 || lm->l_name == nullptr ||
+      strcmp(linker_path, lm->l_name) != 0)
+    return false;
+  g_size_off = l.size_off;
+  g_next_off = l.next_off;
+  g_ctor_off = l.ctor_off;
+  return true;
+}
+
 /* Resolve linker symbols and offsets. */
 bool u_init() {
   if (g_unload_done)
     return g_unload_ok;
   g_unload_done = true;
 
-  LinkerSyms syms;
-  if (!syms.init())
+  if (!linker_view().ok)
     return false;
 
-  uintptr_t head_var = syms.find("__dl__ZL8solinker");
-  if (head_var == 0)
-    head_var = syms.find("__dl__ZL6solist");
-  uintptr_t somain_var = syms.find("__dl__ZL6somain");
-  uintptr_t vdso_var = syms.find("__dl__ZL4vdso");
-  g_soinfo_unload = reinterpret_cast<void (*)(void *)>(
-      syms.find("__dl__ZL13soinfo_unloadP6soinfo"));
-  g_load_counter = reinterpret_cast<uint64_t *>(
-      syms.find("__dl__ZL21g_module_load_counter"));
-  g_unload_counter = reinterpret_cast<uint64_t *>(
-      syms.find("__dl__ZL23g_module_unload_counter"));
-  g_realpath_u = reinterpret_cast<realpath_fn>(
-      syms.find("__dl__ZNK6soinfo12get_realpathEv"));
-  g_soname_u = reinterpret_cast<realpath_fn>(
-      syms.find("__dl__ZNK6soinfo10get_sonameEv"));
+  uintptr_t head_var = linker_sym(kSymSolinker, kSymSolist);
+  uintptr_t somain_var = linker_sym(kSymSomain);
+  uintptr_t vdso_var = linker_sym(kSymVdso);
+  g_soinfo_unload =
+      reinterpret_cast<void (*)(void *)>(linker_sym(kSymSoinfoUnload));
+  g_load_counter = reinterpret_cast<uint64_t *>(linker_sym(kSymLoadCounter));
+  g_unload_counter =
+      reinterpret_cast<uint64_t *>(linker_sym(kSymUnloadCounter));
+  g_realpath_u = reinterpret_cast<realpath_fn>(linker_sym(kSymGetRealpath));
+  g_soname_u = reinterpret_cast<realpath_fn>(linker_sym(kSymGetSoname));
   g_pdg_ctor_u =
-      reinterpret_cast<guard_fn>(syms.find("__dl__ZN18ProtectedDataGuardC2Ev"));
-  if (g_pdg_ctor_u == nullptr)
-    g_pdg_ctor_u = reinterpret_cast<guard_fn>(
-        syms.find("__dl__ZN18ProtectedDataGuardC1Ev"));
+      reinterpret_cast<guard_fn>(linker_sym(kSymGuardC2, kSymGuardC1));
   g_pdg_dtor_u =
-      reinterpret_cast<guard_fn>(syms.find("__dl__ZN18ProtectedDataGuardD2Ev"));
-  if (g_pdg_dtor_u == nullptr)
-    g_pdg_dtor_u = reinterpret_cast<guard_fn>(
-        syms.find("__dl__ZN18ProtectedDataGuardD1Ev"));
+      reinterpret_cast<guard_fn>(linker_sym(kSymGuardD2, kSymGuardD1));
 
   if (head_var == 0 || somain_var == 0 || g_soinfo_unload == nullptr ||
       g_realpath_u == nullptr || g_pdg_ctor_u == nullptr ||
@@ -314,14 +481,20 @@ bool u_init() {
     return false;
   }
 
-  if (!u_probe_offsets(somain, g_solist_head, vdso, hp)) {
-    SLOGE("solist-unload: offset probe failed [size=%zu next=%zu ctor=%zu]",
-          g_size_off, g_next_off, g_ctor_off);
-    return false;
+  bool adopted = u_adopt_offsets(g_offered, somain, g_solist_head, vdso, hp);
+  if (!adopted) {
+    if (!u_probe_offsets(somain, g_solist_head, vdso, hp)) {
+      SLOGE("solist-unload: offset probe failed [size=%zu next=%zu ctor=%zu]",
+            g_size_off, g_next_off, g_ctor_off);
+      return false;
+    }
+    g_probed = {linker_build_id(), static_cast<uint16_t>(g_size_off),
+                static_cast<uint16_t>(g_next_off),
+                static_cast<uint16_t>(g_ctor_off)};
   }
 
-  SLOGI("solist-unload: ready [size=%zu next=%zu ctor=%zu] unload=%p",
-        g_size_off, g_next_off, g_ctor_off,
+  SLOGI("solist-unload: ready [size=%zu next=%zu ctor=%zu, %s] unload=%p",
+        g_size_off, g_next_off, g_ctor_off, adopted ? "prepared" : "probed",
         reinterpret_cast<void *>(g_soinfo_unload));
   g_unload_ok = true;
   return true;
@@ -329,28 +502,29 @@ bool u_init() {
 
 } // namespace
 
+bool prepare_linker_view() { return linker_view().ok; }
+
+void offer_soinfo_layout(const SoinfoLayout &layout) { g_offered = layout; }
+
+bool probed_soinfo_layout(SoinfoLayout *out) {
+  if (g_probed.linker_id == 0)
+    return false;
+  *out = g_probed;
+  return true;
+}
+
 int hide_from_solist(const char *path_substr) {
-  LinkerSyms syms;
-  if (!syms.init()) {
+  if (!linker_view().ok) {
     SLOGE("solist: cannot resolve linker64 .symtab; skip hiding");
     return 0;
   }
 
-  uintptr_t head_var = syms.find("__dl__ZL8solinker");
-  if (head_var == 0)
-    head_var = syms.find("__dl__ZL6solist");
-  auto realpath = reinterpret_cast<realpath_fn>(
-      syms.find("__dl__ZNK6soinfo12get_realpathEv"));
-  guard_fn pdg_ctor =
-      reinterpret_cast<guard_fn>(syms.find("__dl__ZN18ProtectedDataGuardC2Ev"));
-  if (pdg_ctor == nullptr)
-    pdg_ctor = reinterpret_cast<guard_fn>(
-        syms.find("__dl__ZN18ProtectedDataGuardC1Ev"));
-  guard_fn pdg_dtor =
-      reinterpret_cast<guard_fn>(syms.find("__dl__ZN18ProtectedDataGuardD2Ev"));
-  if (pdg_dtor == nullptr)
-    pdg_dtor = reinterpret_cast<guard_fn>(
-        syms.find("__dl__ZN18ProtectedDataGuardD1Ev"));
+  uintptr_t head_var = linker_sym(kSymSolinker, kSymSolist);
+  auto realpath = reinterpret_cast<realpath_fn>(linker_sym(kSymGetRealpath));
+  auto pdg_ctor =
+      reinterpret_cast<guard_fn>(linker_sym(kSymGuardC2, kSymGuardC1));
+  auto pdg_dtor =
+      reinterpret_cast<guard_fn>(linker_sym(kSymGuardD2, kSymGuardD1));
 
   if (head_var == 0 || realpath == nullptr || pdg_ctor == nullptr ||
       pdg_dtor == nullptr) {
@@ -507,27 +681,17 @@ uintptr_t cfi_shadow_offset(uintptr_t addr) {
 }
 
 bool find_cfi_shadow(CfiShadowRange *out) {
-  FILE *fp = fopen("/proc/self/maps", "re");
-  if (fp == nullptr)
+  bool found = false;
+  for_each_map([&](const MapEntry &e) {
+    if (strcmp(e.path, "[anon:cfi shadow]") != 0)
+      return true;
+    out->start = e.start;
+    out->end = e.end;
+    out->prot = perms_prot(e.perms);
+    found = true;
     return false;
-  char line[512];
-  while (fgets(line, sizeof(line), fp) != nullptr) {
-    if (strstr(line, "[anon:cfi shadow]") == nullptr)
-      continue;
-    uintptr_t start = 0, end = 0;
-    char perms[5] = {};
-    if (sscanf(line, "%lx-%lx %4s", &start, &end, perms) != 3)
-      continue;
-    out->start = start;
-    out->end = end;
-    out->prot = (perms[0] == 'r' ? PROT_READ : 0) |
-                (perms[1] == 'w' ? PROT_WRITE : 0) |
-                (perms[2] == 'x' ? PROT_EXEC : 0);
-    (void)fclose(fp);
-    return true;
-  }
-  (void)fclose(fp);
-  return false;
+  });
+  return found;
 }
 
 bool sync_cfi_shadow(uintptr_t old_start, uintptr_t new_start, size_t size) {
@@ -577,84 +741,90 @@ int spoof_virtual_maps(const char *path_substr, bool private_only) {
   struct Range {
     uintptr_t start, end;
     int prot;
+    int segs;
   };
-  Range ranges[64];
-  int nr = 0;
-
-  FILE *fp = fopen("/proc/self/maps", "re");
-  if (fp == nullptr)
-    return 0;
-  char line[512];
-  while (nr < 64 && fgets(line, sizeof(line), fp) != nullptr) {
-    if (strstr(line, path_substr) == nullptr)
-      continue;
-    uintptr_t start = 0, end = 0;
-    char perms[5] = {};
-    if (sscanf(line, "%lx-%lx %4s", &start, &end, perms) != 3)
-      continue;
-    if (private_only && perms[3] != 'p')
-      continue; // skip shared mappings (e.g. ART's own memfd) when asked
-    int prot = (perms[0] == 'r' ? PROT_READ : 0) |
-               (perms[1] == 'w' ? PROT_WRITE : 0) |
-               (perms[2] == 'x' ? PROT_EXEC : 0);
-    ranges[nr++] = {start, end, prot};
-  }
-  (void)fclose(fp);
-
-  int done = 0;
-  for (int i = 0; i < nr; ++i) {
-    size_t size = ranges[i].end - ranges[i].start;
-    void *addr = reinterpret_cast<void *>(ranges[i].start);
-    void *copy = mmap(nullptr, size, PROT_READ | PROT_WRITE,
-                      MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if (copy == MAP_FAILED)
-      continue;
-    if ((ranges[i].prot & PROT_READ) == 0)
-      mprotect(addr, size, PROT_READ);
-    memcpy(copy, addr, size);
-    if (mremap(copy, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, addr) ==
-        MAP_FAILED) {
-      munmap(copy, size);
-      continue;
-    }
-    mprotect(addr, size, ranges[i].prot);
-    if (ranges[i].prot & PROT_EXEC) {
-      sync_cfi_shadow(ranges[i].start, ranges[i].start, size);
-      __builtin___clear_cache(reinterpret_cast<char *>(addr),
-                              reinterpret_cast<char *>(ranges[i].start + size));
+  constexpr int kBatch = 64;
+  timespec t0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  /* Batches of coalesced ranges; each rescan resumes past the last batch. */
+  int done = 0, matched = 0, remaps = 0;
+  uintptr_t cursor = 0;
+  for (bool full = true; full;) {
+    Range ranges[kBatch];
+    int nr = 0;
+    full = false;
+    for_each_map([&](const MapEntry &e) {
+      if (e.start < cursor || strstr(e.path, path_substr) == nullptr)
+        return true;
+      if (private_only && e.perms[3] != 'p')
+        return true; // skip shared mappings (e.g. ART's own memfd) when asked
+      int prot = perms_prot(e.perms);
+      if (nr > 0 && ranges[nr - 1].end == e.start &&
+          ranges[nr - 1].prot == prot) {
+        ranges[nr - 1].end = e.end;
+        ++ranges[nr - 1].segs;
+      } else if (nr == kBatch) {
+        full = true;
+        return false;
+      } else {
+        ranges[nr++] = {e.start, e.end, prot, 1};
+      }
+      ++matched;
+      return true;
+    });
+    if (nr == 0)
+      break;
+    cursor = ranges[nr - 1].end;
+
+    for (int i = 0; i < nr; ++i) {
+      size_t size = ranges[i].end - ranges[i].start;
+      void *addr = reinterpret_cast<void *>(ranges[i].start);
+      void *copy = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+      if (copy == MAP_FAILED)
+        continue;
+      if ((ranges[i].prot & PROT_READ) == 0)
+        mprotect(addr, size, PROT_READ);
+      memcpy(copy, addr, size);
+      if (mremap(copy, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, addr) ==
+          MAP_FAILED) {
+        munmap(copy, size);
+        continue;
+      }
+      if (ranges[i].prot != (PROT_READ | PROT_WRITE))
+        mprotect(addr, size, ranges[i].prot);
+      if (ranges[i].prot & PROT_EXEC) {
+        sync_cfi_shadow(ranges[i].start, ranges[i].start, size);
+        __builtin___clear_cache(
+            reinterpret_cast<char *>(addr),
+            reinterpret_cast<char *>(ranges[i].start + size));
+      }
+      done += ranges[i].segs;
+      ++remaps;
     }
-    ++done;
   }
-  SLOGI("maps-spoof: anonymized %d/%d segment(s) matching '%s'", done, nr,
-        path_substr);
+
+  timespec t1;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  long us = ((t1.tv_sec - t0.tv_sec) * 1000000L) +
+            ((t1.tv_nsec - t0.tv_nsec) / 1000);
+  SLOGI("maps-spoof: anonymized %d/%d segment(s) matching '%s' in %d remap(s), "
+        "%ld us",
+        done, matched, path_substr, remaps, us);
   return done;
 }
 
 int name_anonymous_exec() {
-  FILE *fp = fopen("/proc/self/maps", "re");
-  if (fp == nullptr)
-    return 0;
-  char line[512];
   int n = 0;
-  while (fgets(line, sizeof(line), fp) != nullptr) {
-    uintptr_t start = 0, end = 0;
-    char perms[5] = {};
-    int path_off = 0;
-    if (sscanf(line, "%lx-%lx %4s %*s %*s %*s %n", &start, &end, perms,
-               &path_off) < 3)
-      continue;
-    if (strchr(perms, 'x') == nullptr)
-      continue; // executable only
-    const char *path = line + path_off;
-    while (*path == ' ')
-      ++path;
-    if (*path != '\0' && *path != '\n')
-      continue; // already named or file-backed -> leave alone
-    prctl(PR_SET_VMA, PR_SET_VMA_ANON_NAME, reinterpret_cast<void *>(start),
-          end - start, "dalvik-jit-code-cache");
+  for_each_map([&n](const MapEntry &e) {
+    if (e.perms[2] != 'x' || e.path[0] != '\0')
+      return true; // executable bare anon only; named/file-backed left alone
+    prctl(PR_SET_VMA, PR_SET_VMA_ANON_NAME, reinterpret_cast<void *>(e.start),
+          e.end - e.start, "dalvik-jit-code-cache");
     ++n;
-  }
-  (void)fclose(fp);
+    return true;
+  });
   SLOGI("maps-spoof: named %d bare anon exec seg(s)", n);
   return n;
 }
@@ -10,6 +10,23 @@
 
 namespace yuki::solist {
 
+/* Resolve linker64 symbols once; call in zygote so children inherit. */
+bool prepare_linker_view();
+
+/* soinfo field offsets for one linker build. */
+struct SoinfoLayout {
+  uint64_t linker_id; /* linker build-id prefix; 0 = unknown */
+  uint16_t size_off;
+  uint16_t next_off;
+  uint16_t ctor_off;
+};
+
+/* Offsets prepared elsewhere; used instead of probing if they check out. */
+void offer_soinfo_layout(const SoinfoLayout &layout);
+
+/* Offsets this process had to probe itself; false if none were probed. */
+bool probed_soinfo_layout(SoinfoLayout *out);
+
 /* Unlink matching soinfo entries. */
 int hide_from_solist(const char *path_substr);
 
@@ -180,78 +180,97 @@ struct MetadataPage {
   size_t cursor;
 };
 
+/*
+ * Header of an image-owned block. Owned blocks are chained on their image
+ * and move to the free list when the image is released.
+ */
+struct MetadataBlock {
+  MetadataBlock *next;
+  uint32_t capacity;  // usable bytes after the header
+  uint32_t requested; // bytes handed out for the current owner
+};
+static_assert(sizeof(MetadataBlock) % alignof(max_align_t) == 0);
+
 MetadataPage *g_metadata_pages = nullptr;
+MetadataBlock *g_metadata_free = nullptr;
+
+struct MetadataCounters {
+  size_t pages = 0;
+  size_t mapped_bytes = 0;
+  size_t live_bytes = 0;
+  size_t free_bytes = 0;
+  size_t reused = 0;
+};
+MetadataCounters g_metadata;
 
 #if YUKILINKER_FULL
 pthread_mutex_t g_metadata_mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif // #if YUKILINKER_FULL
 
-void *metadata_allocate(size_t bytes, size_t alignment) {
-  if (bytes == 0 || !is_power_of_two(alignment))
-    return nullptr;
-
+void metadata_lock() {
 #if YUKILINKER_FULL
   pthread_mutex_lock(&g_metadata_mutex);
 #endif // #if YUKILINKER_FULL
+}
 
+void metadata_unlock() {
+#if YUKILINKER_FULL
+  pthread_mutex_unlock(&g_metadata_mutex);
+#endif // #if YUKILINKER_FULL
+}
+
+/* Bump allocation; caller holds the metadata lock. */
+void *metadata_bump(size_t bytes, size_t alignment) {
   size_t header = sizeof(MetadataPage);
   size_t header_aligned =
       (header + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
-  MetadataPage *page = g_metadata_pages;
-  while (page != nullptr) {
+  for (MetadataPage *page = g_metadata_pages; page != nullptr;
+       page = page->next) {
     size_t offset = (page->cursor + alignment - 1) & ~(alignment - 1);
     if (offset <= page->mapped_size && bytes <= page->mapped_size - offset) {
       page->cursor = offset + bytes;
-      void *result = reinterpret_cast<uint8_t *>(page) + offset;
-      memset(result, 0, bytes);
-#if YUKILINKER_FULL
-      pthread_mutex_unlock(&g_metadata_mutex);
-#endif // #if YUKILINKER_FULL
-      return result;
+      return reinterpret_cast<uint8_t *>(page) + offset;
     }
-    page = page->next;
   }
 
   size_t required;
   if (add_overflow(header_aligned, alignment - 1, &required) ||
-      add_overflow(required, bytes, &required)) {
-#if YUKILINKER_FULL
-    pthread_mutex_unlock(&g_metadata_mutex);
-#endif // #if YUKILINKER_FULL
+      add_overflow(required, bytes, &required))
     return nullptr;
-  }
   uintptr_t rounded;
-  if (!page_ceil(required, &rounded)) {
-#if YUKILINKER_FULL
-    pthread_mutex_unlock(&g_metadata_mutex);
-#endif // #if YUKILINKER_FULL
+  if (!page_ceil(required, &rounded))
     return nullptr;
-  }
   size_t mapping_size =
       rounded < kMetadataPageSize ? kMetadataPageSize : rounded;
   void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-  if (mapping == MAP_FAILED) {
-#if YUKILINKER_FULL
-    pthread_mutex_unlock(&g_metadata_mutex);
-#endif // #if YUKILINKER_FULL
+  if (mapping == MAP_FAILED)
     return nullptr;
-  }
 
-  page = static_cast<MetadataPage *>(mapping);
+  auto *page = static_cast<MetadataPage *>(mapping);
   page->next = g_metadata_pages;
   page->mapped_size = mapping_size;
   page->cursor = header_aligned;
   g_metadata_pages = page;
+  ++g_metadata.pages;
+  g_metadata.mapped_bytes += mapping_size;
 
   size_t offset = (page->cursor + alignment - 1) & ~(alignment - 1);
   page->cursor = offset + bytes;
-  void *result = reinterpret_cast<uint8_t *>(page) + offset;
-  memset(result, 0, bytes);
+  return reinterpret_cast<uint8_t *>(page) + offset;
+}
 
-#if YUKILINKER_FULL
-  pthread_mutex_unlock(&g_metadata_mutex);
-#endif // #if YUKILINKER_FULL
+/* Process-lifetime metadata (public handles); never released. */
+void *metadata_allocate(size_t bytes, size_t alignment) {
+  if (bytes == 0 || !is_power_of_two(alignment))
+    return nullptr;
+  metadata_lock();
+  void *result = metadata_bump(bytes, alignment);
+  if (result != nullptr) {
+    memset(result, 0, bytes);
+    g_metadata.live_bytes += bytes;
+  }
+  metadata_unlock();
   return result;
 }
 
@@ -260,6 +279,59 @@ template <typename T> T *metadata_object() {
   return memory == nullptr ? nullptr : new (memory) T{};
 }
 
+/*
+ * Zeroed block of at least `bytes`, reusing a released block when one fits
+ * without wasting more than half of it.
+ */
+MetadataBlock *metadata_block(size_t bytes) {
+  if (bytes == 0 || bytes > UINT32_MAX - alignof(max_align_t))
+    return nullptr;
+  size_t capacity =
+      (bytes + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+  metadata_lock();
+  MetadataBlock *block = nullptr;
+  for (MetadataBlock **link = &g_metadata_free; *link != nullptr;
+       link = &(*link)->next) {
+    size_t have = (*link)->capacity;
+    if (have >= capacity && have / 2 <= capacity) {
+      block = *link;
+      *link = block->next;
+      g_metadata.free_bytes -= have;
+      ++g_metadata.reused;
+      break;
+    }
+  }
+  if (block == nullptr) {
+    block = static_cast<MetadataBlock *>(metadata_bump(
+        sizeof(MetadataBlock) + capacity, alignof(max_align_t)));
+    if (block != nullptr)
+      block->capacity = static_cast<uint32_t>(capacity);
+  }
+  if (block != nullptr) {
+    block->next = nullptr;
+    block->requested = static_cast<uint32_t>(bytes);
+    g_metadata.live_bytes += bytes;
+    memset(block + 1, 0, block->capacity);
+  }
+  metadata_unlock();
+  return block;
+}
+
+/* Return a chain of owned blocks to the free list. */
+void metadata_release(MetadataBlock *chain) {
+  metadata_lock();
+  while (chain != nullptr) {
+    MetadataBlock *next = chain->next;
+    g_metadata.live_bytes -= chain->requested;
+    g_metadata.free_bytes += chain->capacity;
+    chain->requested = 0;
+    chain->next = g_metadata_free;
+    g_metadata_free = chain;
+    chain = next;
+  }
+  metadata_unlock();
+}
+
 struct AddressSpace {
   void *reservation = nullptr;
   size_t span = 0;
@@ -342,8 +414,39 @@ struct ImageState {
 #if YUKILINKER_FULL
   ExitCallback *exit_callbacks = nullptr;
 #endif // #if YUKILINKER_FULL
+  MetadataBlock *metadata = nullptr; // owned blocks, this state's own first
 };
 
+/* Metadata freed together with the image. */
+void *image_allocate(ImageState *image, size_t bytes) {
+  MetadataBlock *block = metadata_block(bytes);
+  if (block == nullptr)
+    return nullptr;
+  block->next = image->metadata->next;
+  image->metadata->next = block;
+  return block + 1;
+}
+
+template <typename T> T *image_object(ImageState *image) {
+  static_assert(alignof(T) <= alignof(max_align_t));
+  void *memory = image_allocate(image, sizeof(T));
+  return memory == nullptr ? nullptr : new (memory) T{};
+}
+
+ImageState *new_image_state() {
+  MetadataBlock *block = metadata_block(sizeof(ImageState));
+  if (block == nullptr)
+    return nullptr;
+  auto *image = new (block + 1) ImageState{};
+  image->metadata = block;
+  return image;
+}
+
+/* Last use of the image: its state block goes back with everything else. */
+void release_image_metadata(ImageState *image) {
+  metadata_release(image->metadata);
+}
+
 ImageState *g_first_image = nullptr;
 ImageState *g_last_image = nullptr;
 
@@ -570,7 +673,8 @@ bool map_one_segment(int fd, const uint8_t *source, size_t file_size,
 
 bool create_address_space(int fd, const uint8_t *source, size_t file_size,
                           const SourceLayout &layout, bool file_backed,
-                          AddressSpace *memory) {
+                          ImageState *image) {
+  AddressSpace *memory = &image->memory;
   size_t span = layout.highest_vaddr - layout.lowest_vaddr;
   void *reservation =
       mmap(nullptr, span, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
@@ -591,8 +695,8 @@ bool create_address_space(int fd, const uint8_t *source, size_t file_size,
     munmap(reservation, span);
     return false;
   }
-  memory->program_headers = static_cast<ElfW(Phdr) *>(
-      metadata_allocate(phdr_bytes, alignof(ElfW(Phdr))));
+  memory->program_headers =
+      static_cast<ElfW(Phdr) *>(image_allocate(image, phdr_bytes));
   if (memory->program_headers == nullptr) {
     munmap(reservation, span);
     return false;
@@ -981,8 +1085,7 @@ void build_symbol_index(ImageState *image) {
   size_t index_bytes;
   if (multiply_overflow(capacity, sizeof(uint32_t), &index_bytes))
     return;
-  auto *slots = static_cast<uint32_t *>(
-      metadata_allocate(index_bytes, alignof(uint32_t)));
+  auto *slots = static_cast<uint32_t *>(image_allocate(image, index_bytes));
   if (slots == nullptr)
     return;
 
@@ -1060,7 +1163,7 @@ bool open_dependencies(ImageState *image, const DynamicParse &parse) {
     if (memchr(name, '\0', image->symbols.string_bytes - entry.d_un.d_val) ==
         nullptr)
       return false;
-    Dependency *dependency = metadata_object<Dependency>();
+    Dependency *dependency = image_object<Dependency>(image);
     if (dependency == nullptr)
       return false;
     dependency->system_handle = ::dlopen(name, RTLD_NOW | RTLD_GLOBAL);
@@ -1787,7 +1890,7 @@ bool apply_relocation(ImageState *image, const ElfW(Rela) & relocation) {
       descriptor[1] = reference.byte_offset;
       return true;
     }
-    auto *cookie = metadata_object<TlsDescriptorIndex>();
+    auto *cookie = image_object<TlsDescriptorIndex>(image);
     if (cookie == nullptr)
       return false;
     cookie->module = reference.module_id;
@@ -1926,14 +2029,17 @@ void release_failed_image(ImageState *image) {
   }
   if (image->public_handle != nullptr) {
     image->public_handle->load_bias = nullptr;
+    image->public_handle->map_start = nullptr;
     image->public_handle->map_size = 0;
     image->public_handle->private_state = nullptr;
   }
+  release_image_metadata(image);
 }
 
 } // namespace
 
-SoHandle *dlopen_memfd(int memfd, const char *vma_name, bool file_backed) {
+SoHandle *dlopen_memfd(int memfd, const char *vma_name, bool file_backed,
+                       bool defer_init) {
   (void)vma_name;
   struct stat status{};
   if (memfd < 0 || fstat(memfd, &status) != 0 || status.st_size <= 0)
@@ -1950,9 +2056,10 @@ SoHandle *dlopen_memfd(int memfd, const char *vma_name, bool file_backed) {
     return nullptr;
   }
 
+  // Handles outlive dlclose() in callers, so they stay in the bump arena.
   SoHandle *handle = metadata_object<SoHandle>();
-  ImageState *image = metadata_object<ImageState>();
-  if (handle == nullptr || image == nullptr) {
+  ImageState *image = handle != nullptr ? new_image_state() : nullptr;
+  if (image == nullptr) {
     munmap(source, file_size);
     return nullptr;
   }
@@ -1960,12 +2067,13 @@ SoHandle *dlopen_memfd(int memfd, const char *vma_name, bool file_backed) {
   image->public_handle = handle;
 
   if (!create_address_space(memfd, static_cast<const uint8_t *>(source),
-                            file_size, layout, file_backed, &image->memory)) {
+                            file_size, layout, file_backed, image)) {
     munmap(source, file_size);
     release_failed_image(image);
     return nullptr;
   }
   handle->load_bias = image->memory.bias;
+  handle->map_start = static_cast<uint8_t *>(image->memory.reservation);
   handle->map_size = image->memory.span;
 
   DynamicParse dynamic;
@@ -1990,10 +2098,17 @@ SoHandle *dlopen_memfd(int memfd, const char *vma_name, bool file_backed) {
 
   munmap(source, file_size);
   register_image(image);
-  run_initializers(image);
+  if (!defer_init)
+    run_initializers(image);
   return handle;
 }
 
+void initialize(SoHandle *handle) {
+  ImageState *image = state_of(handle);
+  if (image != nullptr && !image->lifecycle.initialized)
+    run_initializers(image);
+}
+
 void *dlsym(SoHandle *handle, const char *name) {
   ImageState *image = state_of(handle);
   const ElfW(Sym) *symbol = find_defined_symbol(image, name);
@@ -2012,11 +2127,14 @@ void *dlsym(SoHandle *handle, const char *name) {
                           : nullptr;
 }
 
-void dlclose(SoHandle *handle) {
+namespace {
+
+void release_image(SoHandle *handle, bool finalize) {
   ImageState *image = state_of(handle);
   if (image == nullptr)
     return;
-  run_finalizers(image);
+  if (finalize)
+    run_finalizers(image);
   discard_exit_callbacks(image);
   deactivate_tls(image);
   unregister_image(image);
@@ -2025,8 +2143,32 @@ void dlclose(SoHandle *handle) {
     munmap(image->memory.reservation, image->memory.span);
   image->memory.reservation = nullptr;
   handle->load_bias = nullptr;
+  handle->map_start = nullptr;
   handle->map_size = 0;
   handle->private_state = nullptr;
+  release_image_metadata(image);
+}
+
+} // namespace
+
+void dlclose(SoHandle *handle) { release_image(handle, true); }
+
+void discard(SoHandle *handle) { release_image(handle, false); }
+
+void arena_stats(ArenaStats *out) {
+  metadata_lock();
+  size_t used = 0;
+  for (const MetadataPage *page = g_metadata_pages; page != nullptr;
+       page = page->next)
+    used += page->cursor;
+  out->pages = g_metadata.pages;
+  out->mapped_bytes = g_metadata.mapped_bytes;
+  out->live_bytes = g_metadata.live_bytes;
+  out->free_bytes = g_metadata.free_bytes;
+  // Page headers, block headers, alignment and reuse slack.
+  out->wasted_bytes = used - g_metadata.live_bytes - g_metadata.free_bytes;
+  out->reused = g_metadata.reused;
+  metadata_unlock();
 }
 
 bool has_active_tls() {
@@ -2206,6 +2348,12 @@ yuki_core_dlopen_memfd(int memfd, const char *vma_name) {
   return yukilinker::dlopen_memfd(memfd, vma_name, true);
 }
 
+// Copy-in load for descriptors the caller may not map executable.
+[[gnu::visibility("hidden")]] void *
+yuki_core_dlopen_anon(int fd, const char *vma_name) {
+  return yukilinker::dlopen_memfd(fd, vma_name, false);
+}
+
 [[gnu::visibility("hidden")]] void *yuki_core_dlsym(void *handle,
                                                     const char *name) {
   return yukilinker::dlsym(static_cast<yukilinker::SoHandle *>(handle), name);
@@ -14,11 +14,19 @@ struct SoHandle {
 
   // All loader bookkeeping is private to yukilinker.cpp.
   void *private_state = nullptr;
+
+  // Start of the map_size reservation; equals load_bias only when the lowest
+  // PT_LOAD vaddr is 0. Appended so the handoff prefix above keeps its layout.
+  uint8_t *map_start = nullptr;
 };
 
-// Load an ET_DYN AArch64 image from an already-open descriptor.
+// Load an ET_DYN AArch64 image from an already-open descriptor. With
+// defer_init the constructors only run on a later initialize().
 SoHandle *dlopen_memfd(int memfd, const char *vma_name,
-                       bool file_backed = false);
+                       bool file_backed = false, bool defer_init = false);
+
+// Run the constructors of an image loaded with defer_init; no-op otherwise.
+void initialize(SoHandle *h);
 
 // Find a defined dynamic symbol in a loaded image.
 void *dlsym(SoHandle *h, const char *name);
@@ -26,6 +34,21 @@ void *dlsym(SoHandle *h, const char *name);
 // Run finalizers and release the image mapping.
 void dlclose(SoHandle *h);
 
+// Release the image mapping without running its finalizers or atexit
+// handlers, for images whose code must not run in this process.
+void discard(SoHandle *h);
+
+// Metadata arena usage; released image metadata is kept for reuse.
+struct ArenaStats {
+  size_t pages;        // metadata mappings
+  size_t mapped_bytes; // bytes mapped for them
+  size_t live_bytes;   // held by loaded images and handles
+  size_t free_bytes;   // released, waiting for reuse
+  size_t wasted_bytes; // headers, alignment and reuse slack
+  size_t reused;       // allocations served from released blocks
+};
+void arena_stats(ArenaStats *out);
+
 // Return whether a loaded image still depends on this loader's TLS resolver.
 bool has_active_tls();
 
@@ -7,6 +7,7 @@
 
 #include "inline_hook.hpp"
 #include "log.hpp"
+#include "patch_text.hpp"
 #include "solist.hpp"
 #include "yukilinker.hpp"
 #include "zygiskd.hpp"
@@ -36,6 +37,7 @@
 #include <cstring>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 extern "C" {
@@ -72,6 +74,10 @@ struct ZnSymbolResolver;
 struct ZygiskNextAPI {
   int (*pltHook)(void *base_addr, const char *symbol, void *hook_handler,
                  void **original);
+  /*
+   * Called from onModuleLoaded, *original is callable on return but target
+   * is only patched once onModuleLoaded returns; afterwards it is immediate.
+   */
   int (*inlineHook)(void *target, void *addr, void **original);
   int (*inlineUnhook)(void *target);
   ZnSymbolResolver *(*newSymbolResolver)(const char *path, void *base_addr);
@@ -101,6 +107,8 @@ enum class ZdRequest : uint8_t {
   ConnectNativeCompanion = 16,
   RestoreNativeLoadPolicy = 17,
   ReportNativeInjection = 18,
+  PatchTextBatch = 20,
+  GetNativeMatches = 23,
 };
 
 struct ModuleHandle {
@@ -114,11 +122,6 @@ struct ModuleHandle {
   bool reported = false;
 };
 
-struct InlineHookRecord {
-  void *target = nullptr;
-  yuki::ihook::Hook hook{};
-};
-
 struct ResolvedSymbol {
   std::string name;
   void *addr = nullptr;
@@ -131,7 +134,14 @@ struct ZnSymbolResolver {
   std::vector<ResolvedSymbol> symbols;
 };
 
-std::vector<InlineHookRecord> g_inline_hooks;
+std::unordered_map<void *, yuki::ihook::Hook> g_inline_hooks; // by target
+/*
+ * Prologue patches a module requests from onModuleLoaded are staged here and
+ * applied together once it returns: one patch round trip per module instead
+ * of one per hook. Each trampoline is made callable as it is handed out.
+ */
+yuki::ihook::PatchBatch g_hook_batch;
+bool g_hook_staging = false;
 std::vector<ModuleHandle *> g_loaded_modules;
 yz_config g_yz_config{};
 uintptr_t g_loader_base = 0;
@@ -220,6 +230,10 @@ void load_config() {
   if (write_all(s, &op, 1) && read_all(s, &cfg, sizeof(cfg)))
     g_yz_config = cfg;
   close(s);
+  if (g_yz_config.linker_id != 0) // prepared by the zygote; skips the probe
+    yuki::solist::offer_soinfo_layout(
+        {g_yz_config.linker_id, g_yz_config.soinfo_size_off,
+         g_yz_config.soinfo_next_off, g_yz_config.soinfo_ctor_off});
 }
 
 void restore_native_load_policy() {
@@ -289,6 +303,60 @@ bool request_native_info(uint32_t idx, zygiskd::NativeModuleInfo *info) {
   return ok;
 }
 
+struct NativeMatch {
+  uint32_t index = 0;
+  zygiskd::NativeModuleInfo info{};
+  int fd = -1;
+};
+
+/* zygiskd's match table for this executable in one round trip. */
+bool request_native_matches(const std::string &exe, bool want_fds,
+                            std::vector<NativeMatch> *out) {
+  if (exe.empty() || exe.size() >= zygiskd::kNativeModulePathMax)
+    return false;
+  size_t slash = exe.find_last_of('/');
+  size_t base = slash == std::string::npos ? 0 : slash + 1;
+  zygiskd::NativeMatchQuery q{};
+  q.exe_hash = zygiskd::native_target_hash(exe.data(), exe.size());
+  q.base_hash =
+      zygiskd::native_target_hash(exe.data() + base, exe.size() - base);
+  q.abi = zygiskd::kNativeMatchAbi;
+  q.flags = want_fds ? zygiskd::kNativeMatchWantFds : 0;
+  q.exe_len = static_cast<uint16_t>(exe.size());
+
+  int sock = connect_zygiskd();
+  if (sock < 0)
+    return false;
+  uint8_t op = static_cast<uint8_t>(ZdRequest::GetNativeMatches);
+  uint32_t n = 0;
+  // An older zygiskd drops the unknown request, failing the read.
+  bool ok = write_all(sock, &op, 1) && write_all(sock, &q, sizeof(q)) &&
+            write_all(sock, exe.data(), exe.size()) &&
+            read_all(sock, &n, sizeof(n)) && n <= zygiskd::kNativeMatchMax;
+  std::vector<zygiskd::NativeMatchEntry> entries(ok ? n : 0);
+  if (ok && n != 0)
+    ok = read_all(sock, entries.data(), n * sizeof(entries[0]));
+  if (!ok) {
+    close(sock);
+    return false;
+  }
+  out->clear();
+  out->reserve(n);
+  for (const auto &e : entries) {
+    NativeMatch m;
+    m.index = e.index;
+    m.info = e.info;
+    m.info.module_id[sizeof(m.info.module_id) - 1] = '\0';
+    m.info.target[sizeof(m.info.target) - 1] = '\0';
+    m.info.lib_path[sizeof(m.info.lib_path) - 1] = '\0';
+    // A missing fd is fetched again per module by the caller.
+    m.fd = want_fds ? recv_fd(sock) : -1;
+    out->push_back(m);
+  }
+  close(sock);
+  return true;
+}
+
 bool report_native_injection(uint32_t idx) {
   int sock = connect_zygiskd();
   if (sock < 0) {
@@ -611,38 +679,71 @@ int api_inline_hook(void *target, void *addr, void **original) {
     LOGE("inline hook: invalid args target=%p handler=%p", target, addr);
     return kFailed;
   }
-  for (const auto &rec : g_inline_hooks)
-    if (rec.target == target) {
-      LOGE("inline hook: duplicate target=%p", target);
-      return kFailed;
-    }
+  auto [it, fresh] = g_inline_hooks.try_emplace(target);
+  if (!fresh) {
+    LOGE("inline hook: duplicate target=%p", target);
+    return kFailed;
+  }
 
-  InlineHookRecord rec{};
-  rec.target = target;
-  void *orig = yuki::ihook::install(target, addr, &rec.hook);
+  void *orig = yuki::ihook::install(target, addr, &it->second,
+                                    g_hook_staging ? &g_hook_batch : nullptr);
   if (orig == nullptr) {
+    g_inline_hooks.erase(it);
     LOGE("inline hook: install failed target=%p handler=%p", target, addr);
     return kFailed;
   }
   if (original != nullptr)
     *original = orig;
-  g_inline_hooks.push_back(rec);
-  LOGI("inline hook: installed target=%p handler=%p original=%p", target, addr,
-       orig);
+  if (!it->second.active) {
+    yuki::ihook::publish_slot(it->second.trampoline);
+    LOGI("inline hook: staged target=%p handler=%p original=%p", target, addr,
+         orig);
+    return kSuccess;
+  }
+  unsigned pages = 0;
+  unsigned slots = 0;
+  yuki::ihook::slab_usage(&pages, &slots);
+  LOGI("inline hook: installed target=%p handler=%p original=%p "
+       "(slab %u page(s), %u slot(s))",
+       target, addr, orig, pages, slots);
   return kSuccess;
 }
 
+/* Apply the hooks a module staged; drop the records of any left unwritten. */
+void commit_module_hooks(const std::string &module_id) {
+  g_hook_staging = false;
+  unsigned n = g_hook_batch.n;
+  yuki::ihook::Hook *staged[yuki::ihook::PatchBatch::kMax];
+  std::copy(g_hook_batch.hooks, g_hook_batch.hooks + n, staged);
+  bool ok = yuki::ihook::commit(&g_hook_batch);
+  if (n == 0)
+    return;
+  for (unsigned i = 0; i < n; ++i) {
+    if (staged[i]->active)
+      continue;
+    void *target = staged[i]->target;
+    LOGE("inline hook: patch failed module=%s target=%p", module_id.c_str(),
+         target);
+    g_inline_hooks.erase(target);
+  }
+  unsigned pages = 0;
+  unsigned slots = 0;
+  yuki::ihook::slab_usage(&pages, &slots);
+  LOGI("inline hook: module=%s committed %u hook(s) ok=%u "
+       "(slab %u page(s), %u slot(s))",
+       module_id.c_str(), n, ok ? 1U : 0U, pages, slots);
+}
+
 int api_inline_unhook(void *target) {
   if (target == nullptr)
     return kFailed;
-  for (auto it = g_inline_hooks.begin(); it != g_inline_hooks.end(); ++it) {
-    if (it->target != target)
-      continue;
-    yuki::ihook::uninstall(&it->hook);
-    g_inline_hooks.erase(it);
-    return kSuccess;
-  }
-  return kFailed;
+  auto it = g_inline_hooks.find(target);
+  if (it == g_inline_hooks.end())
+    return kFailed;
+  if (!yuki::ihook::unstage(&g_hook_batch, &it->second))
+    yuki::ihook::uninstall(&it->second);
+  g_inline_hooks.erase(it);
+  return kSuccess;
 }
 
 ZnSymbolResolver *api_new_symbol_resolver(const char *path, void *base_addr) {
@@ -847,7 +948,9 @@ bool load_native_module_from_fd(const zygiskd::NativeModuleInfo &info,
   g_loaded_modules.push_back(handle);
   LOGI("native module onModuleLoaded: %s early=%u", module_id.c_str(),
        early ? 1U : 0U);
+  g_hook_staging = true;
   mod->onModuleLoaded(handle, &g_api);
+  commit_module_hooks(module_id);
   LOGI("native module loaded: %s early=%u", module_id.c_str(), early ? 1U : 0U);
   if (!early)
     handle->reported = report_native_injection(idx);
@@ -925,11 +1028,48 @@ void load_early_modules() {
   close(packet_fd);
 }
 
+void load_native_match(const zygiskd::NativeModuleInfo &info, uint32_t idx,
+                       int lib_fd) {
+  std::string module_id = module_id_of(info);
+  if (auto *loaded = find_loaded_module(module_id)) {
+    if (lib_fd >= 0)
+      close(lib_fd);
+    loaded->index = idx;
+    loaded->has_companion = info.has_companion != 0;
+    LOGI("native core: duplicate skipped id=%s idx=%u early=%u",
+         module_id.c_str(), idx, loaded->early ? 1U : 0U);
+    if (loaded->early && !loaded->reported)
+      loaded->reported = report_native_injection(idx);
+    return;
+  }
+
+  if (lib_fd < 0)
+    lib_fd = request_fd(ZdRequest::GetNativeModuleFd, idx);
+  if (lib_fd < 0) {
+    LOGE("native core: module fd failed id=%s idx=%u", info.module_id, idx);
+    return;
+  }
+  (void)load_native_module_from_fd(info, idx, lib_fd, /*early=*/false);
+}
+
 void load_matching_modules() {
   std::string exe = self_exe_path();
   std::string exe_base = basename_of(exe);
   LOGI("native core: exe=%s base=%s", exe.c_str(), exe_base.c_str());
 
+  std::vector<NativeMatch> matches;
+  if (request_native_matches(exe, /*want_fds=*/true, &matches)) {
+    LOGI("native core: match table modules=%zu", matches.size());
+    for (const auto &m : matches) {
+      LOGI("native core: matched idx=%u id=%s target_type=%u target=%s "
+           "companion=%u fd=%d",
+           m.index, m.info.module_id, m.info.target_type, m.info.target,
+           m.info.has_companion ? 1U : 0U, m.fd);
+      load_native_match(m.info, m.index, m.fd);
+    }
+    return;
+  }
+
   uint32_t count = 0;
   if (!request_native_module_count(&count, /*quiet=*/false))
     return;
@@ -945,26 +1085,8 @@ void load_matching_modules() {
          "companion=%u match=%u",
          i, info.module_id, info.target_type, info.target,
          info.has_companion ? 1U : 0U, matched ? 1U : 0U);
-    if (!matched)
-      continue;
-
-    std::string module_id = module_id_of(info);
-    if (auto *loaded = find_loaded_module(module_id)) {
-      loaded->index = i;
-      loaded->has_companion = info.has_companion != 0;
-      LOGI("native core: duplicate skipped id=%s idx=%u early=%u",
-           module_id.c_str(), i, loaded->early ? 1U : 0U);
-      if (loaded->early && !loaded->reported)
-        loaded->reported = report_native_injection(i);
-      continue;
-    }
-
-    int lib_fd = request_fd(ZdRequest::GetNativeModuleFd, i);
-    if (lib_fd < 0) {
-      LOGE("native core: module fd failed id=%s idx=%u", info.module_id, i);
-      continue;
-    }
-    (void)load_native_module_from_fd(info, i, lib_fd, /*early=*/false);
+    if (matched)
+      load_native_match(info, i, -1);
   }
 }
 
@@ -972,17 +1094,32 @@ bool sync_early_native_reports_once() {
   if (!has_pending_early_report())
     return true;
 
-  uint32_t count = 0;
-  if (!request_native_module_count(&count, /*quiet=*/true))
-    return false;
+  std::vector<NativeMatch> matches;
+  (void)request_native_matches(self_exe_path(), /*want_fds=*/false, &matches);
 
+  uint32_t count = 0;
+  bool have_count = false;
   bool all_reported = true;
   for (auto *h : g_loaded_modules) {
     if (h == nullptr || !h->early || h->reported)
       continue;
 
     bool found = false;
-    for (uint32_t i = 0; i < count; i++) {
+    for (const auto &m : matches) {
+      if (module_id_of(m.info) != h->module_id)
+        continue;
+      h->index = m.index;
+      h->has_companion = m.info.has_companion != 0;
+      h->reported = report_native_injection(m.index);
+      found = true;
+      break;
+    }
+    if (!found && !have_count) {
+      if (!request_native_module_count(&count, /*quiet=*/true))
+        return false;
+      have_count = true;
+    }
+    for (uint32_t i = 0; !found && i < count; i++) {
       zygiskd::NativeModuleInfo info{};
       if (!request_native_info(i, &info))
         continue;
@@ -992,7 +1129,6 @@ bool sync_early_native_reports_once() {
       h->has_companion = info.has_companion != 0;
       h->reported = report_native_injection(i);
       found = true;
-      break;
     }
     if (!found || !h->reported)
       all_reported = false;
@@ -1177,23 +1313,21 @@ extern "C" void yz_klog(const char *fmt, ...) {
   }
 }
 
-extern "C" bool yz_patch_text(uintptr_t addr, const void *bytes,
-                              unsigned int len) {
-  if (bytes == nullptr || len == 0 || len > YZ_PATCH_TEXT_MAX)
-    return false;
+extern "C" unsigned int yz_patch_text_v(const yz_patch_vec *v,
+                                        unsigned int n) {
   int s = connect_zygiskd();
   if (s < 0)
-    return false;
-  uint8_t op = static_cast<uint8_t>(ZdRequest::PatchText);
-  uint64_t a64 = addr;
-  uint32_t l32 = len;
-  uint8_t ack = 0;
-  bool ok = write_all(s, &op, 1) && write_all(s, &a64, sizeof(a64)) &&
-            write_all(s, &l32, sizeof(l32)) && write_all(s, bytes, len);
-  if (ok)
-    ok = read_all(s, &ack, 1) && ack != 0;
+    return 0;
+  unsigned int applied = yuki::patch::send_batch(
+      s, static_cast<uint8_t>(ZdRequest::PatchTextBatch), v, n);
   close(s);
-  return ok;
+  return applied;
+}
+
+extern "C" bool yz_patch_text(uintptr_t addr, const void *bytes,
+                              unsigned int len) {
+  yz_patch_vec v{addr, bytes, len};
+  return yz_patch_text_v(&v, 1) == 1;
 }
 
 extern "C" [[gnu::visibility("default")]] void
@@ -31,6 +31,7 @@
 #include <elf.h>
 #include <pthread.h>
 
+#include <algorithm>
 #include <cctype>
 #include <cerrno>
 #include <climits>
@@ -39,9 +40,11 @@
 #include <cstring>
 #include <deque>
 #include <fstream>
+#include <map>
 #include <ranges>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -96,6 +99,7 @@ constexpr char kModulesDir[] = "/data/adb/modules";
 struct Module {
   std::string name;
   std::string lib_path; // <id>/zygisk/<abi>.so
+  bool preload = false; // zygisk/preload: fork-safe, loaded in zygote
 };
 
 std::vector<Module> g_modules;
@@ -103,6 +107,8 @@ std::vector<Module> g_modules;
 using NativeModule = yukizygisk::native::NativeModule;
 
 std::vector<NativeModule> g_native_modules;
+/* target hash -> g_native_modules index; rebuilt with the module list. */
+std::unordered_multimap<uint64_t, uint32_t> g_native_match;
 
 struct SafemodeStatus {
   bool active = false;
@@ -151,7 +157,8 @@ std::vector<Module> scan_modules() {
     std::string lib = base + "/zygisk/" + kAbi + ".so";
     if (access(lib.c_str(), F_OK) != 0)
       continue;
-    mods.push_back(Module{e->d_name, std::move(lib)});
+    bool preload = access((base + "/zygisk/preload").c_str(), F_OK) == 0;
+    mods.push_back(Module{e->d_name, std::move(lib), preload});
   }
   closedir(d);
   return mods;
@@ -215,9 +222,22 @@ void publish_native_targets() {
   }
 }
 
+void build_native_match_table() {
+  g_native_match.clear();
+  for (size_t i = 0; i < g_native_modules.size(); ++i) {
+    const std::string &target = g_native_modules[i].target;
+    if (target.empty())
+      continue;
+    g_native_match.emplace(
+        zygiskd::native_target_hash(target.data(), target.size()),
+        static_cast<uint32_t>(i));
+  }
+}
+
 void rescan_modules() {
   g_modules = scan_modules();
   g_native_modules = scan_native_modules();
+  build_native_match_table();
   publish_native_targets();
   DLOGI("found %zu zygisk module(s), %zu native module(s) for %s",
         g_modules.size(), g_native_modules.size(), kAbi);
@@ -686,10 +706,15 @@ uint32_t query_flags(uint32_t uid) {
   return flags;
 }
 
-yz_config g_yz_config{1, 0, 0, 0};
+yz_config g_yz_config{1, 0, 0, 0, 0, 0, 0, 0, 0};
 
 void read_yzconfig() {
-  yz_config cfg{1, 0, 0, 0};
+  yz_config cfg{1, 0, 0, 0, 0, 0, 0, 0, 0};
+  // Probed by a zygote, not part of yzconfig.json.
+  cfg.soinfo_size_off = g_yz_config.soinfo_size_off;
+  cfg.soinfo_next_off = g_yz_config.soinfo_next_off;
+  cfg.soinfo_ctor_off = g_yz_config.soinfo_ctor_off;
+  cfg.linker_id = g_yz_config.linker_id;
   int fd = open(ksud::YZCONFIG_PATH, O_RDONLY | O_CLOEXEC);
   if (fd >= 0) {
     std::string buf;
@@ -1084,6 +1109,129 @@ void json_append_escaped(std::string &out, const std::string &s) {
   }
 }
 
+/* Last kTimingWindow samples of one metric, in microseconds. */
+constexpr size_t kTimingWindow = 128;
+struct TimingSamples {
+  std::vector<uint32_t> ring;
+  size_t next = 0;
+
+  void add(uint32_t us) {
+    if (ring.size() < kTimingWindow) {
+      ring.push_back(us);
+      return;
+    }
+    ring[next] = us;
+    next = (next + 1) % kTimingWindow;
+  }
+};
+
+struct ModuleTimingSamples {
+  TimingSamples load, onload, pre, post;
+};
+
+constexpr const char *kSpecPhaseNames[zygiskd::kSpecPhaseCount] = {
+    "fork_pre",
+    "fd_sanitize",
+    "get_flags",
+    "module_load",
+    "onload",
+    "pre_specialize",
+    "post_specialize",
+    "hide_solist",
+    "spoof_maps",
+    "self_unmap",
+};
+
+uint64_t g_timing_reports = 0;
+zygiskd::SpecArena g_last_arena{};
+uint32_t g_peak_arena_live = 0;
+TimingSamples g_phase_samples[zygiskd::kSpecPhaseCount];
+std::map<std::string, ModuleTimingSamples> g_module_samples;
+
+void record_spec_timing(const zygiskd::SpecTiming &t) {
+  ++g_timing_reports;
+  g_last_arena = t.arena;
+  g_peak_arena_live = std::max(g_peak_arena_live, t.arena.live);
+  for (uint32_t i = 0; i < zygiskd::kSpecPhaseCount; ++i)
+    if (t.phase_mask & (1U << i))
+      g_phase_samples[i].add(t.phase_us[i]);
+  uint32_t n = std::min(t.module_count, zygiskd::kSpecModuleMax);
+  for (uint32_t i = 0; i < n; ++i) {
+    const zygiskd::SpecModuleTiming &m = t.modules[i];
+    if (m.index >= g_modules.size())
+      continue;
+    ModuleTimingSamples &ms = g_module_samples[g_modules[m.index].name];
+    ms.load.add(m.load_us);
+    ms.onload.add(m.onload_us);
+    ms.pre.add(m.pre_us);
+    ms.post.add(m.post_us);
+  }
+}
+
+/* {"p50":..,"p90":..,"p99":..} over the current window. */
+void json_append_percentiles(std::string &out, const TimingSamples &t) {
+  std::vector<uint32_t> v = t.ring;
+  uint32_t p[3] = {0, 0, 0};
+  constexpr uint32_t kPct[3] = {50, 90, 99};
+  for (int i = 0; i < 3 && !v.empty(); ++i) {
+    size_t k = (v.size() - 1) * kPct[i] / 100;
+    std::nth_element(v.begin(), v.begin() + static_cast<ptrdiff_t>(k),
+                     v.end());
+    p[i] = v[k];
+  }
+  out += "{\"p50\":";
+  out += std::to_string(p[0]);
+  out += ",\"p90\":";
+  out += std::to_string(p[1]);
+  out += ",\"p99\":";
+  out += std::to_string(p[2]);
+  out += "}";
+}
+
+/* Per-phase and per-module specialization latency, in microseconds. */
+void json_append_timing(std::string &out) {
+  out += "{\"reports\":";
+  out += std::to_string(g_timing_reports);
+  out += ",\"phases\":{";
+  for (uint32_t i = 0; i < zygiskd::kSpecPhaseCount; ++i) {
+    if (i != 0)
+      out += ',';
+    out += '"';
+    out += kSpecPhaseNames[i];
+    out += "\":";
+    json_append_percentiles(out, g_phase_samples[i]);
+  }
+  out += "},\"modules\":[";
+  bool first = true;
+  for (const auto &[name, ms] : g_module_samples) {
+    if (!first)
+      out += ',';
+    first = false;
+    out += "{\"name\":\"";
+    json_append_escaped(out, name);
+    out += "\",\"load\":";
+    json_append_percentiles(out, ms.load);
+    out += ",\"onload\":";
+    json_append_percentiles(out, ms.onload);
+    out += ",\"pre\":";
+    json_append_percentiles(out, ms.pre);
+    out += ",\"post\":";
+    json_append_percentiles(out, ms.post);
+    out += "}";
+  }
+  out += "],\"linker_arena\":{\"pages\":";
+  out += std::to_string(g_last_arena.pages);
+  out += ",\"live\":";
+  out += std::to_string(g_last_arena.live);
+  out += ",\"free\":";
+  out += std::to_string(g_last_arena.free);
+  out += ",\"wasted\":";
+  out += std::to_string(g_last_arena.wasted);
+  out += ",\"peak_live\":";
+  out += std::to_string(g_peak_arena_live);
+  out += "}}";
+}
+
 /* Compact status JSON for the manager. */
 std::string build_status_json() {
   refresh_safemode_status();
@@ -1201,10 +1349,130 @@ std::string build_status_json() {
     s += ",\"state\":\"injected\"";
     s += "}";
   }
-  s += "]}";
+  s += "],\"timing\":";
+  json_append_timing(s);
+  s += "}";
   return s;
 }
 
+bool g_patch_batch_unsupported = false;
+
+/*
+ * One YZ_PATCH_TEXT_BATCH supercall; per-site fallback for older kernels.
+ * Returns how many leading entries may now be patched, so the client only
+ * releases trampolines no written prologue branches to.
+ */
+uint32_t patch_text_batch(uint32_t pid, std::vector<yz_patch_text_entry> &ents,
+                          std::vector<uint8_t> &data) {
+  for (const auto &e : ents)
+    if (e.len == 0 || e.off > data.size() || e.len > data.size() - e.off)
+      return 0;
+  if (!g_patch_batch_unsupported) {
+    yz_patch_text_batch_cmd cmd{};
+    cmd.pid = pid;
+    cmd.count = static_cast<uint32_t>(ents.size());
+    cmd.data_len = static_cast<uint32_t>(data.size());
+    cmd.entries = reinterpret_cast<uintptr_t>(ents.data());
+    cmd.data = reinterpret_cast<uintptr_t>(data.data());
+    if (ksud::ksuctl(KSU_IOCTL_YZ_PATCH_TEXT_BATCH, &cmd) == 0)
+      return cmd.count;
+    // Only a kernel without the batch supercall takes the per-site path; a
+    // failed batch has already been rolled back.
+    if (errno != ENOTTY && errno != ENOSYS)
+      return std::min(cmd.applied, cmd.count);
+    DLOGI("patch text: batch supercall unavailable, using per-site patches");
+    g_patch_batch_unsupported = true;
+  }
+  uint32_t applied = 0;
+  for (const auto &e : ents) {
+    for (uint32_t done = 0; done < e.len;) {
+      yz_patch_text_cmd pcmd{};
+      pcmd.pid = pid;
+      pcmd.addr = e.addr + done;
+      pcmd.len = std::min<uint32_t>(e.len - done, YZ_PATCH_TEXT_MAX);
+      memcpy(pcmd.bytes, data.data() + e.off + done, pcmd.len);
+      if (ksud::ksuctl(KSU_IOCTL_YZ_PATCH_TEXT, &pcmd) != 0)
+        return done != 0 ? applied + 1 : applied; // partly written site
+      done += pcmd.len;
+    }
+    ++applied;
+  }
+  return applied;
+}
+
+void fill_native_info(uint32_t idx, zygiskd::NativeModuleInfo *info) {
+  const NativeModule &m = g_native_modules[idx];
+  info->target_type = m.target_type;
+  info->has_companion = m.has_companion ? 1 : 0;
+  (void)snprintf(info->module_id, sizeof(info->module_id), "%s",
+                 m.module_id.c_str());
+  (void)snprintf(info->target, sizeof(info->target), "%s", m.target.c_str());
+  (void)snprintf(info->lib_path, sizeof(info->lib_path), "%s",
+                 m.lib_path.c_str());
+}
+
+/* Native modules whose target names this executable, in index order. */
+std::vector<uint32_t> match_native_modules(const zygiskd::NativeMatchQuery &q,
+                                           const std::string &exe) {
+  size_t slash = exe.find_last_of('/');
+  std::string base = slash == std::string::npos ? exe : exe.substr(slash + 1);
+  std::vector<uint32_t> out;
+  auto collect = [&](uint64_t hash, uint8_t type, const std::string &want) {
+    auto [lo, hi] = g_native_match.equal_range(hash);
+    for (auto it = lo; it != hi; ++it) {
+      const NativeModule &m = g_native_modules[it->second];
+      if (m.target_type == type && m.target == want) // hash collisions
+        out.push_back(it->second);
+    }
+  };
+  collect(q.exe_hash, YZ_NATIVE_TARGET_PATH, exe);
+  collect(q.base_hash, YZ_NATIVE_TARGET_NAME, base);
+  std::ranges::sort(out);
+  out.erase(std::ranges::unique(out).begin(), out.end());
+  if (out.size() > zygiskd::kNativeMatchMax)
+    out.resize(zygiskd::kNativeMatchMax);
+  return out;
+}
+
+void send_native_matches(int client) {
+  zygiskd::NativeMatchQuery q{};
+  std::string exe;
+  if (!read_exact(client, &q, sizeof(q)) ||
+      q.exe_len >= zygiskd::kNativeModulePathMax)
+    return;
+  exe.resize(q.exe_len);
+  if (!read_exact(client, exe.data(), exe.size()))
+    return;
+
+  std::vector<uint32_t> idx;
+  if (q.abi == zygiskd::kNativeMatchAbi)
+    idx = match_native_modules(q, exe);
+  else
+    DLOGE("native match: abi %u != %u exe=%s", q.abi,
+          zygiskd::kNativeMatchAbi, exe.c_str());
+
+  std::vector<zygiskd::NativeMatchEntry> entries(idx.size());
+  for (size_t i = 0; i < idx.size(); ++i) {
+    entries[i].index = idx[i];
+    fill_native_info(idx[i], &entries[i].info);
+  }
+  uint32_t n = static_cast<uint32_t>(entries.size());
+  if (!write_exact(client, &n, sizeof(n)) ||
+      (n != 0 &&
+       !write_exact(client, entries.data(), n * sizeof(entries[0]))))
+    return;
+  if ((q.flags & zygiskd::kNativeMatchWantFds) == 0)
+    return;
+  for (uint32_t i : idx) {
+    int fd = copy_file_to_memfd(g_native_modules[i].lib_path);
+    bool sent = send_fd(client, fd);
+    if (fd >= 0)
+      close(fd);
+    if (!sent)
+      return;
+  }
+}
+
 void handle_client(int client) {
   uint8_t op = 0;
   if (!read_exact(client, &op, sizeof(op)))
@@ -1231,6 +1499,30 @@ void handle_client(int client) {
       close(fd);
     break;
   }
+  case zygiskd::Request::GetPreloadModules: {
+    std::vector<zygiskd::PreloadModuleInfo> list;
+    for (size_t i = 0; i < g_modules.size(); ++i) {
+      if (!g_modules[i].preload)
+        continue;
+      struct stat st{};
+      if (stat(g_modules[i].lib_path.c_str(), &st) != 0)
+        continue;
+      zygiskd::PreloadModuleInfo info{};
+      info.index = static_cast<uint32_t>(i);
+      (void)snprintf(info.name, sizeof(info.name), "%s",
+                     g_modules[i].name.c_str());
+      info.dev = static_cast<uint64_t>(st.st_dev);
+      info.ino = static_cast<uint64_t>(st.st_ino);
+      info.size = static_cast<uint64_t>(st.st_size);
+      info.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                      st.st_mtim.tv_nsec;
+      list.push_back(info);
+    }
+    uint32_t n = static_cast<uint32_t>(list.size());
+    if (write_exact(client, &n, sizeof(n)) && n != 0)
+      write_exact(client, list.data(), n * sizeof(list[0]));
+    break;
+  }
   case zygiskd::Request::ConnectCompanion: {
     uint32_t idx = 0;
     if (!read_exact(client, &idx, sizeof(idx)) || !ensure_companion(idx)) {
@@ -1388,6 +1680,34 @@ void handle_client(int client) {
     write_exact(client, &ok, sizeof(ok));
     break;
   }
+  case zygiskd::Request::ReportTiming: {
+    zygiskd::SpecTiming t{};
+    if (read_exact(client, &t, sizeof(t)))
+      record_spec_timing(t);
+    break;
+  }
+  case zygiskd::Request::PatchTextBatch: {
+    uint32_t count = 0;
+    uint32_t data_len = 0;
+    if (!read_exact(client, &count, sizeof(count)) ||
+        !read_exact(client, &data_len, sizeof(data_len)) || count == 0 ||
+        count > YZ_PATCH_BATCH_MAX || data_len == 0 ||
+        data_len > YZ_PATCH_BATCH_BYTES)
+      break;
+    std::vector<yz_patch_text_entry> ents(count);
+    std::vector<uint8_t> data(data_len);
+    if (!read_exact(client, ents.data(), count * sizeof(ents[0])) ||
+        !read_exact(client, data.data(), data_len))
+      break;
+    struct ucred cr{};
+    socklen_t crlen = sizeof(cr);
+    uint32_t applied = 0;
+    if (getsockopt(client, SOL_SOCKET, SO_PEERCRED, &cr, &crlen) == 0 &&
+        cr.pid > 0)
+      applied = patch_text_batch(static_cast<uint32_t>(cr.pid), ents, data);
+    write_exact(client, &applied, sizeof(applied));
+    break;
+  }
   case zygiskd::Request::Log: {
     uint16_t len = 0;
     if (!read_exact(client, &len, sizeof(len)) || len == 0 || len > 256)
@@ -1399,6 +1719,28 @@ void handle_client(int client) {
     dlog("core: %s", buf);
     break;
   }
+  case zygiskd::Request::SetSoinfoLayout: {
+    yz_config in{};
+    struct ucred cr{};
+    socklen_t crlen = sizeof(cr);
+    if (!read_exact(client, &in, sizeof(in)) ||
+        getsockopt(client, SOL_SOCKET, SO_PEERCRED, &cr, &crlen) != 0)
+      break;
+    bool from_zygote = std::ranges::any_of(g_zygotes, [&cr](const auto &z) {
+      return z.pid == static_cast<uint32_t>(cr.pid);
+    });
+    // Offsets are re-checked against the live linker before any use.
+    if (!from_zygote || in.linker_id == 0 || in.soinfo_size_off % 8 != 0 ||
+        in.soinfo_next_off % 8 != 0 || in.soinfo_ctor_off == 0)
+      break;
+    g_yz_config.soinfo_size_off = in.soinfo_size_off;
+    g_yz_config.soinfo_next_off = in.soinfo_next_off;
+    g_yz_config.soinfo_ctor_off = in.soinfo_ctor_off;
+    g_yz_config.linker_id = in.linker_id;
+    DLOGI("soinfo layout from pid=%d: size=%u next=%u ctor=%u", cr.pid,
+          in.soinfo_size_off, in.soinfo_next_off, in.soinfo_ctor_off);
+    break;
+  }
   case zygiskd::Request::ReportZygote: {
     struct ucred cr{};
     socklen_t crlen = sizeof(cr);
@@ -1420,19 +1762,14 @@ void handle_client(int client) {
     uint32_t idx = 0;
     zygiskd::NativeModuleInfo info{};
     if (read_exact(client, &idx, sizeof(idx)) &&
-        idx < g_native_modules.size()) {
-      const NativeModule &m = g_native_modules[idx];
-      info.target_type = m.target_type;
-      info.has_companion = m.has_companion ? 1 : 0;
-      (void)snprintf(info.module_id, sizeof(info.module_id), "%s",
-                     m.module_id.c_str());
-      (void)snprintf(info.target, sizeof(info.target), "%s", m.target.c_str());
-      (void)snprintf(info.lib_path, sizeof(info.lib_path), "%s",
-                     m.lib_path.c_str());
-    }
+        idx < g_native_modules.size())
+      fill_native_info(idx, &info);
     write_exact(client, &info, sizeof(info));
     break;
   }
+  case zygiskd::Request::GetNativeMatches:
+    send_native_matches(client);
+    break;
   case zygiskd::Request::GetNativeModuleFd: {
     uint32_t idx = 0;
     if (!read_exact(client, &idx, sizeof(idx)) ||
@@ -6,6 +6,7 @@
  */
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 namespace zygiskd {
@@ -30,6 +31,11 @@ enum class Request : uint8_t {
   ConnectNativeCompanion = 16,
   RestoreNativeLoadPolicy = 17,
   ReportNativeInjection = 18,
+  GetPreloadModules = 19, // -> u32 n, PreloadModuleInfo[n]
+  PatchTextBatch = 20,    // u32 n, u32 data_len, entries[n], data -> u32 done
+  ReportTiming = 21,      // SpecTiming, no reply
+  SetSoinfoLayout = 22,   // struct yz_config (soinfo_* / linker_id), no reply
+  GetNativeMatches = 23,  // NativeMatchQuery, exe -> u32 n, entries, fds
 };
 
 inline constexpr uint32_t kNativeModuleNameMax = 64;
@@ -45,6 +51,97 @@ struct NativeModuleInfo {
   char lib_path[kNativeModulePathMax];
 };
 
+/* FNV-1a 64 of a target string; keys the daemon's native match table. */
+inline constexpr uint64_t native_target_hash(const char *s, size_t n) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < n; ++i) {
+    h ^= static_cast<uint8_t>(s[i]);
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+inline constexpr uint8_t kNativeMatchAbi = sizeof(void *) * 8;
+inline constexpr uint8_t kNativeMatchWantFds = 1U << 0;
+inline constexpr uint32_t kNativeMatchMax = 64;
+
+/* Followed by exe_len bytes of the executable path, no NUL. */
+struct NativeMatchQuery {
+  uint64_t exe_hash;  // native_target_hash(exe path)
+  uint64_t base_hash; // native_target_hash(basename of exe path)
+  uint8_t abi;        // kNativeMatchAbi of the caller
+  uint8_t flags;      // kNativeMatch*
+  uint16_t exe_len;
+  uint32_t reserved;
+};
+
+/* One per matching module; with WantFds, one fd per entry follows. */
+struct NativeMatchEntry {
+  uint32_t index; // for GetNativeModuleFd / ReportNativeInjection
+  NativeModuleInfo info;
+};
+
+inline constexpr uint32_t kModuleNameMax = 64;
+
+/*
+ * Module that ships zygisk/preload: fork-safe, relocated once in zygote.
+ * The library's stat stamp lets a child tell an updated module from the
+ * image zygote inherited.
+ */
+struct PreloadModuleInfo {
+  uint32_t index;
+  char name[kModuleNameMax];
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t size;
+  int64_t mtime_ns;
+};
+
+/* Specialization phases timed in the child; the order is wire format. */
+enum class SpecPhase : uint8_t {
+  ForkPre = 0, // /proc/self/fd snapshot after the real fork
+  FdSanitize,
+  GetFlags,
+  ModuleLoad,
+  OnLoad,
+  PreSpecialize,
+  PostSpecialize,
+  HideSolist,
+  SpoofMaps,
+  SelfUnmap,
+  Count,
+};
+
+inline constexpr uint32_t kSpecPhaseCount =
+    static_cast<uint32_t>(SpecPhase::Count);
+inline constexpr uint32_t kSpecModuleMax = 16;
+
+struct SpecModuleTiming {
+  uint32_t index;
+  uint32_t load_us;
+  uint32_t onload_us;
+  uint32_t pre_us;
+  uint32_t post_us;
+};
+
+/* yukilinker metadata arena at report time, in bytes. */
+struct SpecArena {
+  uint32_t pages;
+  uint32_t live;
+  uint32_t free;
+  uint32_t wasted;
+};
+
+/* One record per specialization. */
+struct SpecTiming {
+  uint32_t uid;
+  uint32_t phase_mask; // bit n set: SpecPhase n ran
+  uint32_t phase_us[kSpecPhaseCount];
+  uint32_t module_count;
+  SpecModuleTiming modules[kSpecModuleMax];
+  SpecArena arena;
+};
+
 #if defined(__LP64__)
 inline constexpr char kSocketName[] = "zygiskd64";
 #else